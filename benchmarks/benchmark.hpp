@@ -0,0 +1,187 @@
+#pragma once
+
+#include "event_channel.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// What the benchmarks have in common: payloads, command line options and how results are written out.
+
+namespace benchmark
+{
+
+// A payload of a cache line.
+struct pod64
+{
+	std::array<std::uint64_t, 8> data;
+};
+
+// Payloads of each category, made out of a sequence number.
+template<typename T>
+T make_payload(std::uint64_t i);
+
+template<>
+inline int make_payload<int>(std::uint64_t i)
+{
+	return static_cast<int>(i);
+}
+
+template<>
+inline pod64 make_payload<pod64>(std::uint64_t i)
+{
+	return pod64{{i, i, i, i, i, i, i, i}};
+}
+
+// Long enough not to fit in std::string's small buffer.
+template<>
+inline std::string make_payload<std::string>(std::uint64_t i)
+{
+	return "a string too long for small buffers #" + std::to_string(i);
+}
+
+template<typename T>
+char const* payload_name();
+
+template<>
+inline char const* payload_name<int>()
+{
+	return "int";
+}
+
+template<>
+inline char const* payload_name<pod64>()
+{
+	return "pod64";
+}
+
+template<>
+inline char const* payload_name<std::string>()
+{
+	return "string";
+}
+
+template<typename DispatchPolicy>
+char const* policy_name()
+{
+	return std::is_same<DispatchPolicy, event_channel::dispatch_policy::sequential>::value ? "sequential" : "parallel";
+}
+
+// Options common to all benchmarks: [--json] [--duration ms].
+struct options
+{
+	bool json = false;							// Write results as JSON rather than as a table.
+	std::chrono::milliseconds duration;			// How long to run each configuration for.
+
+	options(int argc, char* argv[], std::chrono::milliseconds default_duration = std::chrono::milliseconds(200)) : duration(default_duration)
+	{
+		for(int i = 1; i != argc; ++i)
+		{
+			if(std::strcmp(argv[i], "--json") == 0)
+			{
+				json = true;
+			}
+			else if(std::strcmp(argv[i], "--duration") == 0 && i + 1 != argc)
+			{
+				duration = std::chrono::milliseconds(std::atoi(argv[++i]));
+			}
+		}
+	}
+};
+
+// A table of results, one configuration per row, written out as text or as a JSON array of objects.
+class report
+{
+public:
+	struct cell
+	{
+		std::string text;
+		bool number;
+
+		cell(std::string text) : text(std::move(text)), number(false)
+		{}
+
+		cell(char const* text) : text(text), number(false)
+		{}
+
+		template<typename T, typename = std::enable_if_t<std::is_arithmetic<T>::value>>
+		cell(T value) : number(true)
+		{
+			std::ostringstream oss;
+			oss << std::fixed << std::setprecision(std::is_floating_point<T>::value ? 1 : 0) << value;
+			text = oss.str();
+		}
+	};
+
+	explicit report(std::vector<std::string> columns) : columns_(std::move(columns))
+	{}
+
+	void add(std::vector<cell> row)
+	{
+		rows_.push_back(std::move(row));
+	}
+
+	void write(std::ostream& os, bool json) const
+	{
+		if(json)
+		{
+			os << '[';
+			for(std::size_t r = 0; r != rows_.size(); ++r)
+			{
+				os << (r ? ",\n " : "") << '{';
+				for(std::size_t c = 0; c != columns_.size(); ++c)
+				{
+					auto const& value = rows_[r][c];
+					os << (c ? "," : "") << '"' << columns_[c] << "\":" << (value.number ? "" : "\"") << value.text << (value.number ? "" : "\"");
+				}
+				os << '}';
+			}
+			os << "]\n";
+		}
+		else
+		{
+			// Columns are right-aligned and as wide as their widest cell, plus some room.
+			std::vector<int> widths;
+			for(std::size_t c = 0; c != columns_.size(); ++c)
+			{
+				auto width = columns_[c].size();
+				for(auto const& row : rows_)
+				{
+					width = std::max(width, row[c].text.size());
+				}
+				widths.push_back(static_cast<int>(std::max<std::size_t>(width + 2, 14)));
+			}
+
+			for(std::size_t c = 0; c != columns_.size(); ++c)
+			{
+				os << std::setw(widths[c]) << columns_[c];
+			}
+			os << '\n';
+
+			for(auto const& row : rows_)
+			{
+				for(std::size_t c = 0; c != columns_.size(); ++c)
+				{
+					os << std::setw(widths[c]) << row[c].text;
+				}
+				os << '\n';
+			}
+		}
+	}
+
+private:
+	std::vector<std::string> columns_;
+	std::vector<std::vector<cell>> rows_;
+};
+
+}
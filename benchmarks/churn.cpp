@@ -0,0 +1,148 @@
+#include "benchmark.hpp"
+
+#include "event_channel.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Subscriptions churned by several threads, as a service would with per-session tokens, while events are sent at a fixed rate,
+// under both dispatch policies.
+//
+// Each churning thread subscribes a handler with a token and destroys the token right away, over and over.
+// Unsubscribing takes the lock the dispatching thread holds for as long as it dispatches a batch,
+// so the time it takes to destroy a token shows how long churners are held up by dispatching.
+// Events are handled by a handler that stays subscribed throughout. Their latency, corrected for coordinated omission as in the latency benchmark,
+// shows how much dispatching is held up by churners in return.
+
+using clock_type = chrono::steady_clock;
+
+uint64_t const rate = 2000;	// Events per second.
+
+struct stamped
+{
+	clock_type::time_point due;
+};
+
+struct result
+{
+	double churn_per_second;
+	event_channel::histogram::snapshot_t unsubscribe, latency;
+	event_channel::lock_stats dispatchers;
+};
+
+template<typename DispatchPolicy>
+result measure(size_t const churners, chrono::milliseconds const duration)
+{
+	event_channel::channel<DispatchPolicy> c;
+	c.enable_lock_stats();
+
+	event_channel::histogram unsubscribe, latency;
+	atomic<uint64_t> received{0};
+	auto f = [&](stamped const& s)
+	{
+		latency.record(chrono::duration_cast<chrono::nanoseconds>(clock_type::now() - s.due).count());
+		received.fetch_add(1, memory_order_release);
+	};
+	c.template subscribe<decltype(f), stamped const&>(f);
+
+	atomic<bool> stop{false};
+	atomic<uint64_t> churned{0};
+
+	vector<thread> threads;
+	for(size_t t = 0; t != churners; ++t)
+	{
+		threads.emplace_back([&]
+			{
+				auto session = [](stamped const&){};
+
+				uint64_t n = 0;
+				optional<event_channel::token> token;
+				while(!stop.load(memory_order_relaxed))
+				{
+					token.emplace(c.template subscribe<decltype(session), stamped const&>(event_channel::use_token{}, session));
+
+					auto const start = clock_type::now();
+					token.reset();
+					unsubscribe.record(chrono::duration_cast<chrono::nanoseconds>(clock_type::now() - start).count());
+
+					++n;
+				}
+				churned += n;
+			});
+	}
+
+	auto const interval = chrono::nanoseconds(1000000000 / rate);
+	auto const count = static_cast<uint64_t>(rate * duration.count() / 1000);
+
+	auto const start = clock_type::now();
+	for(uint64_t i = 0; i != count; ++i)
+	{
+		auto const due = start + i * interval;
+		if(due - clock_type::now() > chrono::microseconds(100))
+		{
+			this_thread::sleep_until(due - chrono::microseconds(100));
+		}
+		while(clock_type::now() < due)
+		{
+			this_thread::yield();
+		}
+
+		c.send(stamped{due});
+	}
+
+	stop = true;
+	for(auto& t : threads)
+	{
+		t.join();
+	}
+
+	chrono::duration<double> const elapsed = clock_type::now() - start;
+
+	while(received.load(memory_order_acquire) != count)
+	{
+		this_thread::yield();
+	}
+
+	return {churned / elapsed.count(), unsubscribe.snapshot(), latency.snapshot(), c.lock_contention().dispatchers};
+}
+
+template<typename DispatchPolicy>
+void run(benchmark::report& report, benchmark::options const& options)
+{
+	for(size_t const churners : {0, 1, 2, 4, 8})
+	{
+		auto const r = measure<DispatchPolicy>(churners, options.duration);
+		auto const us = [](uint64_t ns){ return ns / 1000.; };
+
+		report.add({benchmark::policy_name<DispatchPolicy>(), churners, r.churn_per_second,
+					us(r.unsubscribe.percentile(50)), us(r.unsubscribe.percentile(99)), us(r.unsubscribe.max),
+					us(r.latency.percentile(50)), us(r.latency.percentile(99)), us(r.latency.max),
+					r.dispatchers.contended, us(r.dispatchers.wait.count())});
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	benchmark::options const options(argc, argv, chrono::milliseconds(500));
+
+	// Unsubscribing is timed by destroying a token. Latencies are those of events handled while churning.
+	// Contention is that of the lock guarding subscribers, taken by the dispatching thread and by every subscription and unsubscription.
+	benchmark::report report({"policy", "churners", "churn/s",
+							  "unsub p50 (us)", "unsub p99 (us)", "unsub max (us)",
+							  "p50 (us)", "p99 (us)", "max (us)",
+							  "contended", "wait (us)"});
+
+	run<event_channel::dispatch_policy::sequential>(report, options);
+	run<event_channel::dispatch_policy::parallel>(report, options);
+
+	report.write(cout, options.json);
+
+	return 0;
+}
@@ -0,0 +1,151 @@
+#include "benchmark.hpp"
+
+#include "event_channel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+// How dispatching scales with the number of handlers subscribed to an event type and with how long each handler takes,
+// under both dispatch policies.
+//
+// A handler's cost is busy work calibrated against the clock and timed on its own. What an invocation takes beyond that is the policy's overhead,
+// which for the parallel policy includes launching a thread with std::async for each handler of each event.
+// A few events are kept in flight so that the dispatching thread is never starved nor buried under a queue it would take long to drain.
+
+using clock_type = chrono::steady_clock;
+
+size_t const in_flight = 8;
+
+void spin(uint64_t iterations)
+{
+	for(volatile uint64_t i = 0; i < iterations; i = i + 1);
+}
+
+// Iterations of spin per nanosecond on this machine, from the fastest of a few runs so that preemption doesn't skew it.
+double iterations_per_ns()
+{
+	static double const calibrated = []
+		{
+			uint64_t const iterations = 10000000;
+			double fastest = 0;
+			for(int r = 0; r != 5; ++r)
+			{
+				auto const start = clock_type::now();
+				spin(iterations);
+				fastest = max(fastest, iterations / double(chrono::duration_cast<chrono::nanoseconds>(clock_type::now() - start).count()));
+			}
+			return fastest;
+		}();
+
+	return calibrated;
+}
+
+struct result
+{
+	double events_per_second;
+	double cost;		// Nanoseconds the handler's busy work actually takes, on its own.
+	double per_handler;	// Nanoseconds per handler invocation.
+};
+
+template<typename DispatchPolicy>
+result measure(size_t const subscribers, chrono::nanoseconds const cost, chrono::milliseconds const duration)
+{
+	event_channel::channel<DispatchPolicy> c;
+
+	auto const iterations = static_cast<uint64_t>(cost.count() * iterations_per_ns());
+
+	auto const repetitions = max<uint64_t>(1, chrono::nanoseconds(chrono::milliseconds(10)) / cost);
+	auto const before = clock_type::now();
+	for(uint64_t r = 0; r != repetitions; ++r)
+	{
+		spin(iterations);
+	}
+	auto const actual_cost = chrono::duration_cast<chrono::nanoseconds>(clock_type::now() - before).count() / double(repetitions);
+
+	atomic<uint64_t> invocations{0};
+	auto f = [&](int)
+	{
+		spin(iterations);
+		invocations.fetch_add(1, memory_order_relaxed);
+	};
+	for(size_t s = 0; s != subscribers; ++s)
+	{
+		c.template subscribe<decltype(f), int>(f);
+	}
+
+	auto const handled = [&]{ return invocations.load(memory_order_relaxed) / subscribers; };
+
+	uint64_t sent = 0;
+	auto const start = clock_type::now();
+	while(clock_type::now() - start < duration)
+	{
+		while(sent - handled() >= in_flight)
+		{
+			this_thread::yield();
+		}
+
+		c.send(int(sent++));
+	}
+
+	while(handled() != sent)
+	{
+		this_thread::yield();
+	}
+
+	chrono::duration<double> const elapsed = clock_type::now() - start;
+
+	return {sent / elapsed.count(), actual_cost, elapsed.count() * 1e9 / (sent * subscribers)};
+}
+
+// What it takes to launch and wait on a task that does nothing, as the parallel policy does for each handler.
+double async_round_trip(chrono::milliseconds const duration)
+{
+	uint64_t count = 0;
+	auto const start = clock_type::now();
+	while(clock_type::now() - start < duration)
+	{
+		async([]{ return true; }).get();
+		++count;
+	}
+
+	return chrono::duration_cast<chrono::nanoseconds>(clock_type::now() - start).count() / double(count);
+}
+
+template<typename DispatchPolicy>
+void run(benchmark::report& report, benchmark::options const& options)
+{
+	for(size_t const subscribers : {1, 10, 100, 1000})
+	{
+		for(chrono::nanoseconds const cost : {chrono::nanoseconds(10), chrono::nanoseconds(1000), chrono::nanoseconds(100000)})
+		{
+			auto const r = measure<DispatchPolicy>(subscribers, cost, options.duration);
+			report.add({benchmark::policy_name<DispatchPolicy>(), subscribers, cost.count(), r.cost, r.events_per_second, r.per_handler, r.per_handler - r.cost});
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	benchmark::options const options(argc, argv);
+
+	iterations_per_ns();
+
+	benchmark::report report({"policy", "subscribers", "cost (ns)", "actual (ns)", "events/s", "per handler (ns)", "overhead (ns)"});
+
+	auto const async = async_round_trip(options.duration);
+	report.add({"std::async", 1, 0, 0., 1e9 / async, async, async});
+
+	run<event_channel::dispatch_policy::sequential>(report, options);
+	run<event_channel::dispatch_policy::parallel>(report, options);
+
+	report.write(cout, options.json);
+
+	return 0;
+}
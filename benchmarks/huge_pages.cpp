@@ -0,0 +1,102 @@
+#include "event_channel.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory_resource>
+#include <string>
+
+using namespace std;
+
+// Dispatch throughput of a channel whose event buffers are large enough for TLB misses to show,
+// with and without huge pages backing them, and with and without reserving them ahead.
+
+struct message
+{
+	array<uint64_t, 3> data;
+};
+
+volatile uint64_t sink;
+
+double events_per_second(pmr::memory_resource* resource, bool const reserve, size_t const event_count, int const repetitions)
+{
+	event_channel::channel<> c(resource);
+	if(reserve)
+	{
+		c.warm_up<void (message const&)>(event_count);
+	}
+
+	atomic<size_t> received{0};
+	promise<void> done;
+	uint64_t sum = 0;
+
+	auto f = [&](message const& m)
+	{
+		sum += m.data[0];
+		if(++received == event_count)
+		{
+			done.set_value();
+		}
+	};
+	c.subscribe<decltype(f), message const&>(f);
+
+	chrono::duration<double> elapsed{0};
+	for(int r = 0; r != repetitions; ++r)
+	{
+		received = 0;
+		done = promise<void>();
+		auto const all_received = done.get_future();
+
+		auto const start = chrono::steady_clock::now();
+		for(size_t i = 0; i != event_count; ++i)
+		{
+			c.send(message{{i, i, i}});
+		}
+		all_received.wait();
+		elapsed += chrono::steady_clock::now() - start;
+	}
+
+	// Keep the reads being timed from being optimized away.
+	sink = sum;
+
+	return event_count * repetitions / elapsed.count();
+}
+
+size_t const event_count = 4 * 1024 * 1024;
+int const repetitions = 5;
+
+void print(string const& name, pmr::memory_resource* resource)
+{
+	cout << setw(24) << left << name << fixed << setprecision(0)
+		 << setw(16) << right << events_per_second(resource, true, event_count, repetitions)
+		 << setw(16) << right << events_per_second(resource, false, event_count, repetitions) << endl;
+}
+
+int main()
+{
+	cout << setw(24) << left << "resource" << setw(16) << right << "reserved" << setw(16) << right << "not reserved" << endl;
+
+	print("default", pmr::get_default_resource());
+
+	{
+		pmr::synchronized_pool_resource pool;
+		print("pool", &pool);
+	}
+
+	{
+		event_channel::huge_page_resource huge_pages;
+		print("huge pages", &huge_pages);
+
+		pmr::synchronized_pool_resource pool(&huge_pages);
+		print("pool over huge pages", &pool);
+
+		cout << endl << "huge page allocations: " << huge_pages.huge_page_allocations()
+			 << ", transparent huge page allocations: " << huge_pages.advised_allocations()
+			 << ", fallback allocations: " << huge_pages.upstream_allocations() << endl;
+	}
+
+	return 0;
+}
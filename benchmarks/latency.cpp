@@ -0,0 +1,109 @@
+#include "benchmark.hpp"
+
+#include "event_channel.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+// Send-to-handler latency of events sent at a fixed rate, under both dispatch policies.
+//
+// Each event is due at a point in time set by the rate. If sending falls behind, it catches up without waiting.
+// The corrected latency is measured from when the event was due rather than from when it was sent,
+// so that a stall is accounted for in all the events it delays and not only in the one it happened to (coordinated omission).
+//
+// At low rates, the dispatching thread goes back to waiting on its condition variable between events and has to be woken up for each one.
+// At high rates, events queue up while a batch is dispatched and are picked up without waiting.
+
+using clock_type = chrono::steady_clock;
+
+struct stamped
+{
+	clock_type::time_point due;		// When the event should have been sent.
+	clock_type::time_point sent;	// When it was sent.
+};
+
+struct latencies
+{
+	event_channel::histogram::snapshot_t corrected, uncorrected;
+};
+
+template<typename DispatchPolicy>
+latencies measure(uint64_t const rate, chrono::milliseconds const duration)
+{
+	event_channel::channel<DispatchPolicy> c;
+
+	event_channel::histogram corrected, uncorrected;
+	atomic<uint64_t> received{0};
+	auto f = [&](stamped const& s)
+	{
+		auto const now = clock_type::now();
+		corrected.record(chrono::duration_cast<chrono::nanoseconds>(now - s.due).count());
+		uncorrected.record(chrono::duration_cast<chrono::nanoseconds>(now - s.sent).count());
+		received.fetch_add(1, memory_order_release);
+	};
+	c.template subscribe<decltype(f), stamped const&>(f);
+
+	auto const interval = chrono::nanoseconds(1000000000 / rate);
+	auto const count = static_cast<uint64_t>(rate * duration.count() / 1000);
+
+	auto const start = clock_type::now();
+	for(uint64_t i = 0; i != count; ++i)
+	{
+		auto const due = start + i * interval;
+
+		// Sleeping is too coarse for short intervals, spinning is too wasteful for long ones.
+		if(due - clock_type::now() > chrono::microseconds(100))
+		{
+			this_thread::sleep_until(due - chrono::microseconds(100));
+		}
+		while(clock_type::now() < due)
+		{
+			this_thread::yield();
+		}
+
+		c.send(stamped{due, clock_type::now()});
+	}
+
+	while(received.load(memory_order_acquire) != count)
+	{
+		this_thread::yield();
+	}
+
+	return {corrected.snapshot(), uncorrected.snapshot()};
+}
+
+template<typename DispatchPolicy>
+void run(benchmark::report& report, benchmark::options const& options)
+{
+	for(uint64_t const rate : {1000, 10000, 100000})
+	{
+		auto const l = measure<DispatchPolicy>(rate, options.duration);
+		auto const us = [](uint64_t ns){ return ns / 1000.; };
+
+		report.add({benchmark::policy_name<DispatchPolicy>(), rate, l.corrected.count,
+					us(l.corrected.percentile(50)), us(l.corrected.percentile(99)), us(l.corrected.percentile(99.9)), us(l.corrected.max),
+					us(l.uncorrected.percentile(50)), us(l.uncorrected.percentile(99)), us(l.uncorrected.percentile(99.9)), us(l.uncorrected.max)});
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	benchmark::options const options(argc, argv, chrono::milliseconds(1000));
+
+	// Latencies in microseconds, corrected then as seen from the time of sending.
+	benchmark::report report({"policy", "events/s", "events",
+							  "p50 (us)", "p99 (us)", "p99.9 (us)", "max (us)",
+							  "raw p50 (us)", "raw p99 (us)", "raw p99.9 (us)", "raw max (us)"});
+
+	run<event_channel::dispatch_policy::sequential>(report, options);
+	run<event_channel::dispatch_policy::parallel>(report, options);
+
+	report.write(cout, options.json);
+
+	return 0;
+}
@@ -0,0 +1,302 @@
+#include "benchmark.hpp"
+
+#include "event_channel.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// How many bytes a channel takes on its own, per queued event for each payload category and per subscription for each kind of handler.
+//
+// Bytes are counted three ways: those allocated from the channel's memory resource, those allocated from the global heap
+// (e.g. by a std::string's buffer) and the growth of the process' resident memory, where it can be read.
+// Events are queued on a stopped channel so that none is dispatched while counting.
+
+// Every allocation from the global heap goes through these replacements of operator new.
+// They keep the size of each allocation ahead of it to account for it when it is freed.
+namespace
+{
+
+atomic<int64_t> heap_bytes{0};
+thread_local bool in_resource = false;	// Allocations made on behalf of counting_resource are counted by it instead.
+
+size_t const header = alignof(max_align_t);
+
+void* allocate(size_t size)
+{
+	auto const p = static_cast<unsigned char*>(malloc(size + header));
+	if(!p)
+	{
+		throw bad_alloc();
+	}
+
+	*reinterpret_cast<size_t*>(p) = size;
+	if(!in_resource)
+	{
+		heap_bytes += size;
+	}
+
+	return p + header;
+}
+
+void deallocate(void* p)
+{
+	if(p)
+	{
+		auto const q = static_cast<unsigned char*>(p) - header;
+		if(!in_resource)
+		{
+			heap_bytes -= *reinterpret_cast<size_t*>(q);
+		}
+		free(q);
+	}
+}
+
+}
+
+void* operator new(size_t size)
+{
+	return allocate(size);
+}
+
+void* operator new[](size_t size)
+{
+	return allocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	deallocate(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	deallocate(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	deallocate(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	deallocate(p);
+}
+
+// A memory resource that keeps track of how many bytes are allocated from it.
+class counting_resource : public pmr::memory_resource
+{
+public:
+	int64_t bytes() const
+	{
+		return bytes_;
+	}
+
+private:
+	atomic<int64_t> bytes_{0};
+
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		in_resource = true;
+		auto const p = pmr::new_delete_resource()->allocate(bytes, alignment);
+		in_resource = false;
+
+		bytes_ += bytes;
+		return p;
+	}
+
+	void do_deallocate(void* p, size_t bytes, size_t alignment) override
+	{
+		in_resource = true;
+		pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+		in_resource = false;
+
+		bytes_ -= bytes;
+	}
+
+	bool do_is_equal(memory_resource const& other) const noexcept override
+	{
+		return this == &other;
+	}
+};
+
+// Resident memory of the process, in bytes. 0 where it can't be read.
+int64_t resident()
+{
+#if defined(__linux__)
+	ifstream statm("/proc/self/statm");
+	int64_t size = 0, pages = 0;
+	statm >> size >> pages;
+	return pages * sysconf(_SC_PAGESIZE);
+#else
+	return 0;
+#endif
+}
+
+// Bytes allocated, or grown, between its construction and a call to report.
+class footprint
+{
+public:
+	explicit footprint(counting_resource const& resource) : resource_(resource), resource_start_(resource.bytes()), heap_start_(heap_bytes), resident_start_(resident())
+	{}
+
+	void report(benchmark::report& report, char const* measure, char const* category, size_t const count) const
+	{
+		auto const resource = resource_.bytes() - resource_start_, heap = heap_bytes - heap_start_, resident_bytes = resident() - resident_start_;
+		report.add({measure, category, count, resource, heap, resident_bytes, double(resource + heap) / count, double(resident_bytes) / count});
+	}
+
+private:
+	counting_resource const& resource_;
+	int64_t const resource_start_, heap_start_, resident_start_;
+};
+
+size_t const queued_events = 100000;
+
+template<typename Payload>
+void queued(benchmark::report& report)
+{
+	counting_resource resource;
+	event_channel::channel<> c(&resource);
+	c.stop();
+
+	// What a payload allocates itself, e.g. a std::string's buffer, is part of what its event costs.
+	footprint const f(resource);
+	for(size_t i = 0; i != queued_events; ++i)
+	{
+		c.send(benchmark::make_payload<Payload>(i));
+	}
+	f.report(report, "queued event", benchmark::payload_name<Payload>(), queued_events);
+
+	// A channel must be running when destroyed.
+	c.start();
+}
+
+size_t const subscriptions = 64;
+
+atomic<size_t> handled{0};
+
+template<size_t I>
+void on_event(int)
+{
+	++handled;
+}
+
+struct receiver
+{
+	void on_event(int)
+	{
+		++handled;
+	}
+};
+
+// Subscribes handlers with subscribe and reports what they take once they have all handled an event.
+template<typename Subscribe>
+void subscribed(benchmark::report& report, char const* kind, Subscribe&& subscribe)
+{
+	counting_resource resource;
+	event_channel::channel<> c(&resource);
+
+	// First events have the channel allocate what it needs regardless of subscribers, e.g. a chunk for each of its two event queues.
+	for(int i = 0; i != 2; ++i)
+	{
+		c.send(0);
+		this_thread::sleep_for(chrono::milliseconds(10));
+	}
+
+	footprint const f(resource);
+
+	handled = 0;
+	subscribe(c);
+	c.send(0);
+	while(handled != subscriptions)
+	{
+		this_thread::yield();
+	}
+
+	f.report(report, "subscription", kind, subscriptions);
+}
+
+template<size_t... Is>
+void subscribe_functions(event_channel::channel<>& c, index_sequence<Is...>)
+{
+	(c.subscribe(&on_event<Is>), ...);
+}
+
+int main(int argc, char* argv[])
+{
+	benchmark::options const options(argc, argv);
+
+	benchmark::report report({"measure", "category", "count", "resource (B)", "heap (B)", "resident (B)", "per item (B)", "resident per item (B)"});
+
+	report.add({"sizeof", "channel<>", 1, int64_t(0), int64_t(0), int64_t(0), double(sizeof(event_channel::channel<>)), 0.});
+
+	{
+		counting_resource resource;
+		footprint const f(resource);
+		event_channel::channel<> c(&resource);
+		this_thread::sleep_for(chrono::milliseconds(10));
+		f.report(report, "idle channel", "channel<>", 1);
+	}
+
+	queued<int>(report);
+	queued<benchmark::pod64>(report);
+	queued<string>(report);
+
+	subscribed(report, "function", [](event_channel::channel<>& c)
+		{
+			subscribe_functions(c, make_index_sequence<subscriptions>());
+		});
+
+	vector<receiver> receivers(subscriptions);
+	subscribed(report, "member", [&](event_channel::channel<>& c)
+		{
+			for(auto& r : receivers)
+			{
+				c.subscribe(&r, &receiver::on_event);
+			}
+		});
+
+	vector<shared_ptr<receiver>> shared_receivers;
+	for(size_t i = 0; i != subscriptions; ++i)
+	{
+		shared_receivers.push_back(make_shared<receiver>());
+	}
+	subscribed(report, "shared_ptr member", [&](event_channel::channel<>& c)
+		{
+			for(auto const& r : shared_receivers)
+			{
+				c.subscribe(r, &receiver::on_event);
+			}
+		});
+
+	subscribed(report, "lambda", [](event_channel::channel<>& c)
+		{
+			for(size_t i = 0; i != subscriptions; ++i)
+			{
+				auto f = [](int){ ++handled; };
+				c.subscribe<decltype(f), int>(f);
+			}
+		});
+
+	report.write(cout, options.json);
+
+	return 0;
+}
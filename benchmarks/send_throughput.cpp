@@ -0,0 +1,97 @@
+#include "benchmark.hpp"
+
+#include "event_channel.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Sustained events/second through channel::send as the number of producer threads grows,
+// for payloads of several sizes, under both dispatch policies.
+//
+// Producers send as fast as they can for a while, held back by a memory budget so that they can't outrun the dispatching thread forever.
+// Throughput counts events from the first send to the last one being handled.
+
+size_t const budget = 1024 * 1024;
+
+template<typename DispatchPolicy, typename Payload>
+double events_per_second(size_t const producers, chrono::milliseconds const duration)
+{
+	event_channel::channel<DispatchPolicy> c;
+	c.memory_budget(budget);
+
+	atomic<uint64_t> received{0};
+	auto f = [&](Payload const&){ received.fetch_add(1, memory_order_relaxed); };
+	c.template subscribe<decltype(f), Payload const&>(f);
+
+	atomic<bool> stop{false};
+	atomic<uint64_t> sent{0};
+
+	auto const start = chrono::steady_clock::now();
+
+	vector<thread> threads;
+	for(size_t p = 0; p != producers; ++p)
+	{
+		threads.emplace_back([&]
+			{
+				uint64_t i = 0;
+				while(!stop.load(memory_order_relaxed))
+				{
+					c.send(benchmark::make_payload<Payload>(i++));
+				}
+				sent += i;
+			});
+	}
+
+	this_thread::sleep_for(duration);
+	stop = true;
+	for(auto& t : threads)
+	{
+		t.join();
+	}
+
+	while(received.load(memory_order_relaxed) != sent)
+	{
+		this_thread::yield();
+	}
+
+	chrono::duration<double> const elapsed = chrono::steady_clock::now() - start;
+
+	return sent / elapsed.count();
+}
+
+template<typename DispatchPolicy, typename Payload>
+void run(benchmark::report& report, benchmark::options const& options)
+{
+	for(size_t producers = 1; producers <= 64; producers *= 2)
+	{
+		report.add({benchmark::policy_name<DispatchPolicy>(), benchmark::payload_name<Payload>(), producers, events_per_second<DispatchPolicy, Payload>(producers, options.duration)});
+	}
+}
+
+template<typename DispatchPolicy>
+void run(benchmark::report& report, benchmark::options const& options)
+{
+	run<DispatchPolicy, int>(report, options);
+	run<DispatchPolicy, benchmark::pod64>(report, options);
+	run<DispatchPolicy, string>(report, options);
+}
+
+int main(int argc, char* argv[])
+{
+	benchmark::options const options(argc, argv);
+
+	benchmark::report report({"policy", "payload", "producers", "events/s"});
+
+	run<event_channel::dispatch_policy::sequential>(report, options);
+	run<event_channel::dispatch_policy::parallel>(report, options);
+
+	report.write(cout, options.json);
+
+	return 0;
+}
@@ -83,7 +83,7 @@ This code compiles successfully with AppleClang 7.0.0, VC++ 14 and g++ 5.1.1.
 \subsection policies Policy-based design
 
 Like other libraries of mine, I often follow principles of <a href="https://en.wikipedia.org/wiki/Policy-based_design">policy-based design</a>.
-\ref event_channel::channel currently supports two policies.
+\ref event_channel::channel currently supports three policies.
 
 \subsubsection dispatch Event dispatching policy
  
@@ -97,6 +97,129 @@ The second policy dictates what happens to events when the \ref event_channel::c
 When \ref event_channel::channel is instantiated with its idle policy set to \ref event_channel::idle_policy::keep_events, unprocessed and incoming events will kept in the queue and processed when the channel is restarted.
 Conversely, when the idle policy is set to \ref event_channel::idle_policy::drop_events, unprocessed and incoming events will be discarded as long as the channel is idle.
 
+\subsubsection instrumentation Instrumentation policy
+
+The third policy is a set of hooks called as an event is queued, as a batch of events starts and ends being dispatched and around every handler invocation.
+It is meant as a single extension point for tracing, profiling and debugging.
+The default, \ref event_channel::instrumentation_policy::none, does nothing and compiles away entirely.
+
+\ref event_channel::instrumentation_policy::trace feeds \ref event_channel::trace_recorder, which keeps per-thread ring buffers of send instants, batch spans and handler spans.
+Recording is toggled at runtime and the buffers are written out in Chrome's trace event format, to be viewed in chrome://tracing or Perfetto.
+
+\code
+event_channel::channel<event_channel::dispatch_policy::parallel, event_channel::idle_policy::keep_events, event_channel::instrumentation_policy::trace> c;
+event_channel::trace_recorder::instance().enable();
+...
+event_channel::trace_recorder::instance().enable(false);
+std::ofstream trace("trace.json");
+event_channel::trace_recorder::instance().write(trace);
+\endcode
+
+\subsection memory Memory resources
+
+Everything \ref event_channel::channel allocates (queued events, subscribed handlers and the containers holding them) comes from a <a href="http://en.cppreference.com/w/cpp/memory/memory_resource">std::pmr::memory_resource</a> given at construction.
+It defaults to <tt>std::pmr::get_default_resource()</tt>.
+Since events are allocated by sending threads and deallocated by the dispatching thread, the resource must be thread-safe.
+
+\code
+std::pmr::synchronized_pool_resource pool;
+event_channel::channel<> c(&pool);
+\endcode
+
+For channels holding many events, \ref event_channel::huge_page_resource can back such a pool with 2 MiB huge pages to cut down on TLB misses.
+It falls back to regular pages when huge pages aren't available.
+The \c huge_pages benchmark compares dispatch throughput with and without it.
+
+The bytes held by queued events are accounted for and reported by \ref event_channel::channel::memory_usage "memory_usage".
+By default, an event accounts for the \c sizeof of its parameters. Specialize \ref event_channel::payload_size for types that own heap memory.
+A budget can be set with \ref event_channel::channel::memory_budget "memory_budget".
+Once it's exceeded, senders either block until enough events have been dispatched (\ref event_channel::budget_policy::block) or their events are dropped (\ref event_channel::budget_policy::drop_events).
+Memory held by subscribers can be measured through the memory resource.
+
+\subsection intrusive Intrusive events
+
+Types deriving from \ref event_channel::intrusive_node can be sent with \ref event_channel::channel::send_intrusive "send_intrusive".
+The channel links them in its queue through the hook they embed, never copies them, and hands them back through their completion callback once all handlers have returned.
+This makes for an allocation-free send and dispatch of caller-owned (e.g. pooled) objects.
+
+Similarly, \ref event_channel::channel::send_borrowed "send_borrowed" sends a non-owning view (e.g. a <tt>std::string_view</tt> of a network buffer) along with a callback to release the underlying buffer once handlers are done with it.
+The buffer itself is never copied.
+
+\subsection zero_allocation Zero allocation
+
+Queued events are stored back to back, each as a small header followed by its parameters constructed in place, so that an event takes as much memory as its parameters do.
+They are laid out in chunks of memory that are recycled between senders and the dispatching thread.
+Handlers whose callables fit in four pointers are stored inline rather than allocated.
+Hence, once \ref event_channel::channel::reserve "reserve" has been called and a first batch of events has been dispatched, sending and dispatching events with \ref event_channel::dispatch_policy::sequential does not allocate.
+This is verified by the \c allocations test which replaces the global <tt>operator new</tt>.
+Note that \ref event_channel::dispatch_policy::parallel does allocate since it relies on \c std::async.
+
+Rather than sending a first round of events, \ref event_channel::channel::warm_up "warm_up" can be called with the expected event types and volume.
+It also spares the first events the page faults of fresh event buffers and of the dispatching thread's stack.
+
+\code
+c.warm_up<void (int), void (std::string const&)>(1024);
+\endcode
+
+\subsection metrics Metrics
+
+Once enabled with \ref event_channel::channel::enable_metrics "enable_metrics", a channel counts, per event type, events sent, dispatched, dropped and filtered (i.e. sent while nobody was subscribed).
+It also times how long events wait in the queue and how long each handler invocation takes.
+Durations are recorded in lock-free, logarithmic, \ref event_channel::histogram "histograms" from which percentiles can be read.
+\ref event_channel::channel::metrics "metrics" returns a snapshot of it all, queue depth included, and is cheap enough to be polled.
+When disabled, metrics cost a branch per event and per handler invocation.
+
+\code
+c.enable_metrics();
+...
+for(auto const& m : c.metrics())
+{
+	std::cout << m.type.name() << ": " << m.queue_depth << " queued, p99 " << m.latency.percentile(99) << "ns\n";
+}
+\endcode
+
+The queue itself can be watched in real time: \ref event_channel::channel::pending "pending" and \ref event_channel::channel::oldest_age "oldest_age" tell how many events wait and for how long, and \ref event_channel::channel::batch_sizes "batch_sizes" how many the dispatching thread takes at once.
+With \ref event_channel::channel::on_lag "on_lag", the dispatching thread itself calls back when the lag of a batch crosses a threshold, e.g. to shed load.
+
+To tell whether senders and the dispatching thread get in each other's way, \ref event_channel::channel::enable_lock_stats "enable_lock_stats" has the channel's locks account for their acquisitions, contended acquisitions, wait time and longest hold, and its condition variables for their wake-ups, spurious or not.
+\ref event_channel::channel::lock_contention "lock_contention" reports them.
+
+To monitor a process from the outside, \ref event_channel::metrics_exporter publishes a channel's metrics in a named shared memory segment, guarded by a sequence lock so that readers never block the process.
+\ref event_channel::metrics_reader reads them back and the \c metrics_reader tool prints them as a table or as JSON, e.g. <tt>metrics_reader my_service --json --watch 1000</tt>.
+
+Channels registered with \ref event_channel::metrics_registry are rendered together as OpenMetrics text, i.e. what Prometheus scrapes: counters, gauges and latency histograms labelled by channel and event type.
+\ref event_channel::metrics_registry::write_file "write_file" replaces a file at once so that it can be served, e.g. by node_exporter's textfile collector, while being updated.
+
+When handlers send events of their own, \ref event_channel::flow_graph can sample their invocations to capture which event types lead to which, through which handler, how often and how fast.
+Written out as Graphviz or JSON, the graph reveals an application's topology and its amplification loops.
+
+Every event type sent or subscribed to is listed by \ref event_channel::type_registry::types "type_registry::types" with its demangled name, size, alignment, whether its parameters are trivially copyable and how many of its events are alive.
+It tells which event types are large or expensive to copy and helps size a channel's memory budget.
+
+To find out which handler slows a channel down, \ref event_channel::channel::enable_profiling "enable_profiling" has every handler account for its invocations, wall time and CPU time.
+\ref event_channel::channel::slowest_handlers "slowest_handlers" then reports the slowest ones by tag and subscriber type and can be written out as a table.
+
+\code
+c.enable_profiling();
+...
+std::cout << c.slowest_handlers(5);
+\endcode
+
+\subsection benchmarks Benchmarks
+
+The benchmarks under \c benchmarks/ each run a matrix of configurations and print one row per configuration, as a table or, given \c --json, as JSON.
+\c --duration sets how many milliseconds each configuration runs for.
+
+- \c send_throughput: sustained events/second through \ref event_channel::channel::send "send" from 1 to 64 producer threads, for \c int, 64-byte and \c std::string payloads, under both dispatch policies.
+- \c latency: send-to-handler latency percentiles of events sent at 1,000 to 100,000 events/second, corrected for coordinated omission by measuring from when each event was due rather than from when it was sent.
+  Changes to the dispatching thread's loop should not make it worse.
+- \c fan_out: throughput and overhead per handler invocation with 1 to 1,000 handlers per event type costing 10 ns to 100 us each, under both dispatch policies, next to the cost of a bare \c std::async.
+  It tells which dispatch policy suits a workload.
+- \c churn: 0 to 8 threads subscribing and unsubscribing with tokens while events are sent at a fixed rate.
+  It reports how fast subscriptions churn, how long destroying a token waits for the dispatching thread and how late events are handled in return.
+- \c memory_footprint: the size of a channel, what an idle one allocates, and the bytes taken by each queued event and each subscription, for each payload category and kind of handler.
+  Bytes are counted from the channel's memory resource, from the global heap and from the growth of resident memory.
+
 \section improvements Future improvements
  
 More test cases. More. More!
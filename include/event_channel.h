@@ -1,13 +1,25 @@
 #pragma once
 
-#include <any>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstdint>
+#include <cstdio>
+#include <fstream>
 #include <functional>
 #include <future>
 #include <map>
 #include <memory>
+#include <memory_resource>
 #include <mutex>
+#include <new>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
 #include <thread>
 #include <tuple>
 #include <typeindex>
@@ -16,210 +28,2725 @@
 #include <utility>
 #include <vector>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#if defined(__GNUG__)
+#include <cstdlib>
+#include <cxxabi.h>
+#endif
+
 //! Encompasses everything related to event channel.
 namespace event_channel
 {
 
+template<class DispatchPolicy, bool IdlePolicy, class InstrumentationPolicy>
+class channel;
+
 using handler_tag_t = uintptr_t;	//!< Tag returned when subscribing callable.
 
-//! Private namespace, not to be used by end-users.
-namespace detail
-{
+//! Number of bytes an event parameter accounts for against a channel's \ref channel::memory_budget "memory budget".
+//!
+//! Defaults to \c sizeof(T). Specialize it for types owning heap memory, e.g.:
+//! \code
+//! template<>
+//! struct event_channel::payload_size<std::string>
+//! {
+//!     std::size_t operator()(std::string const& s) const { return sizeof(s) + s.capacity(); }
+//! };
+//! \endcode
+template<typename T>
+struct payload_size
+{
+	std::size_t operator()(T const&) const
+	{
+		return sizeof(T);
+	}
+};
+
+//! Memory accounting of a channel's queued events. See \ref channel::memory_usage.
+struct memory_stats
+{
+	std::size_t current = 0;	//!< Bytes held by queued and in-flight events.
+	std::size_t peak = 0;		//!< Highest value \ref current has reached.
+	std::size_t budget = 0;		//!< Bytes allowed before the budget policy kicks in. 0 for no budget.
+	std::size_t dropped = 0;	//!< Number of events dropped, either when idle or when over budget.
+};
+
+//! Sizes of the batches of events the dispatching thread has taken from the queue. See \ref channel::batch_sizes.
+struct batch_stats
+{
+	std::uint64_t batches = 0;	//!< Number of batches dispatched.
+	std::uint64_t events = 0;	//!< Number of events in all batches, intrusive ones included.
+	std::uint64_t max = 0;		//!< Size of the largest batch.
+	std::uint64_t last = 0;		//!< Size of the latest batch.
+
+	double mean() const
+	{
+		return batches ? double(events) / batches : 0.;
+	}
+};
+
+//! Contention of one of a channel's locks. See \ref channel::lock_contention.
+struct lock_stats
+{
+	std::uint64_t acquisitions = 0;		//!< Number of times the lock was taken.
+	std::uint64_t contended = 0;		//!< Number of times the lock was already held by another thread.
+	std::chrono::nanoseconds wait{0};	//!< Time spent waiting for the lock when contended.
+	std::chrono::nanoseconds max_hold{0};	//!< Longest time the lock was held in one go.
+};
+
+//! Wake-ups of one of a channel's condition variables. See \ref channel::lock_contention.
+struct wakeup_stats
+{
+	std::uint64_t wakeups = 0;		//!< Number of times a waiting thread woke up.
+	std::uint64_t spurious = 0;		//!< Number of times it did so only to find that what it waited for hadn't happened.
+};
+
+//! Contention of a channel's locks and condition variables. See \ref channel::lock_contention.
+struct contention_stats
+{
+	lock_stats events;				//!< Guards the event queue. Taken by senders and the dispatching thread.
+	lock_stats dispatchers;			//!< Guards subscribers. Held by the dispatching thread while dispatching.
+	lock_stats dispatchers_pending;	//!< Guards subscribers added while dispatching.
+	wakeup_stats events_queued;		//!< The dispatching thread waiting for events.
+	wakeup_stats budget;			//!< Senders waiting for room in the memory budget.
+	wakeup_stats warmed_up;			//!< Callers of \ref channel::warm_up waiting for the dispatching thread.
+};
+
+//! A lock-free histogram of durations, in nanoseconds, with logarithmic buckets in the manner of HdrHistogram.
+//!
+//! Each power of two is divided in \ref sub_buckets buckets, bounding the relative error of reported values to 1 / \ref sub_buckets.
+//! Recording is wait-free and can be done concurrently from any thread.
+class histogram
+{
+public:
+	static unsigned const sub_bucket_bits = 3;
+	static std::uint64_t const sub_buckets = std::uint64_t{1} << sub_bucket_bits;	//!< Number of buckets per power of two.
+	static unsigned const max_bits = 44;												//!< Values are clamped below 2^max_bits ns, a little under five hours.
+	static std::size_t const bucket_count = (max_bits - sub_bucket_bits + 1) * sub_buckets;
+
+	//! A copy of a histogram's data at a point in time.
+	struct snapshot_t
+	{
+		std::array<std::uint64_t, bucket_count> counts{};
+		std::uint64_t count = 0, sum = 0, max = 0;
+
+		double mean() const
+		{
+			return count ? double(sum) / count : 0.;
+		}
+
+		//! The value under which lies \p p percent of recorded values, rounded up to its bucket's upper bound.
+		std::uint64_t percentile(double p) const
+		{
+			auto const rank = static_cast<std::uint64_t>(p / 100. * count + .5);
+
+			std::uint64_t seen = 0;
+			for(std::size_t i = 0; i != bucket_count; ++i)
+			{
+				seen += counts[i];
+				if(seen && seen >= rank)
+				{
+					return std::min(upper_bound(i), max);
+				}
+			}
+
+			return max;
+		}
+	};
+
+	//! Index of the bucket \p value falls into.
+	static std::size_t index(std::uint64_t value)
+	{
+		value = std::min(value, (std::uint64_t{1} << max_bits) - 1);
+
+		if(value < sub_buckets)
+		{
+			return static_cast<std::size_t>(value);
+		}
+
+		unsigned msb = 0;
+		for(unsigned shift = 32; shift; shift /= 2)
+		{
+			if(value >> (msb + shift))
+			{
+				msb += shift;
+			}
+		}
+
+		unsigned const shift = msb - sub_bucket_bits;
+		return static_cast<std::size_t>(((shift + 1) << sub_bucket_bits) + ((value >> shift) - sub_buckets));
+	}
+
+	//! Highest value falling into bucket \p i.
+	static std::uint64_t upper_bound(std::size_t i)
+	{
+		if(i < sub_buckets)
+		{
+			return i;
+		}
+
+		auto const shift = (i >> sub_bucket_bits) - 1;
+		return ((sub_buckets + (i & (sub_buckets - 1)) + 1) << shift) - 1;
+	}
+
+	void record(std::uint64_t value)
+	{
+		counts_[index(value)].fetch_add(1, std::memory_order_relaxed);
+		count_.fetch_add(1, std::memory_order_relaxed);
+		sum_.fetch_add(value, std::memory_order_relaxed);
+
+		auto max = max_.load(std::memory_order_relaxed);
+		while(value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed));
+	}
+
+	snapshot_t snapshot() const
+	{
+		snapshot_t s;
+		for(std::size_t i = 0; i != bucket_count; ++i)
+		{
+			s.counts[i] = counts_[i].load(std::memory_order_relaxed);
+		}
+		s.count = count_.load(std::memory_order_relaxed);
+		s.sum = sum_.load(std::memory_order_relaxed);
+		s.max = max_.load(std::memory_order_relaxed);
+		return s;
+	}
+
+private:
+	std::array<std::atomic<std::uint64_t>, bucket_count> counts_{};
+	std::atomic<std::uint64_t> count_{0}, sum_{0}, max_{0};
+};
+
+//! Metrics of a type of event. See \ref channel::metrics.
+struct event_type_metrics
+{
+	std::type_index type = typeid(void);	//!< The event's type, a std::tuple of its parameters.
+	std::uint64_t sent = 0;					//!< Number of events sent, whether they were queued or dropped.
+	std::uint64_t dispatched = 0;			//!< Number of events dispatched to at least one handler.
+	std::uint64_t dropped = 0;				//!< Number of events dropped, either when idle or when over budget, whether they were queued or not.
+	std::uint64_t filtered = 0;				//!< Number of events dispatched to no handler since none was subscribed.
+	std::uint64_t queue_depth = 0;			//!< Number of events queued but not yet dispatched.
+	histogram::snapshot_t latency;			//!< Time from an event being sent to it being dispatched, in nanoseconds.
+	histogram::snapshot_t handler_duration;	//!< Time spent in each handler invocation, in nanoseconds.
+};
+
+//! Profile of an event handler. See \ref channel::slowest_handlers.
+struct handler_profile
+{
+	handler_tag_t tag = 0;
+	std::string event_type;				//!< Demangled name of the event's type, a std::tuple of its parameters.
+	std::string handler_type;			//!< Demangled name of the subscribed callable, member function or function pointer.
+	std::uint64_t invocations = 0;
+	std::chrono::nanoseconds total{0};	//!< Wall time spent in the handler.
+	std::chrono::nanoseconds max{0};	//!< Longest wall time spent in a single invocation.
+	std::chrono::nanoseconds cpu{0};	//!< CPU time spent by the invoking thread in the handler, where supported.
+};
+
+//! Writes \p profiles as a table, one handler per line.
+inline std::ostream& operator<<(std::ostream& os, std::vector<handler_profile> const& profiles)
+{
+	os << "invocations\ttotal (ns)\tmax (ns)\tcpu (ns)\ttag\tevent\thandler\n";
+	for(auto const& p : profiles)
+	{
+		os << p.invocations << '\t' << p.total.count() << '\t' << p.max.count() << '\t' << p.cpu.count() << '\t' << p.tag << '\t' << p.event_type << '\t' << p.handler_type << '\n';
+	}
+
+	return os;
+}
+
+//! Private namespace, not to be used by end-users.
+namespace detail
+{
+
+using clock_t = std::chrono::steady_clock;	//!< Clock by which events are timed.
+
+//! Live metrics of a type of event, updated as events go through a channel.
+struct type_metrics
+{
+	std::type_index type;
+	std::atomic<std::uint64_t> sent{0}, dispatched{0}, dropped{0}, filtered{0};
+	histogram latency, handler_duration;
+
+	explicit type_metrics(std::type_index type) : type(type)
+	{}
+};
+
+inline std::size_t next_type_ordinal()
+{
+	static std::atomic<std::size_t> ordinal{0};
+	return ordinal++;
+}
+
+//! A dense, process-wide, number identifying \p T.
+template<typename T>
+std::size_t type_ordinal()
+{
+	static std::size_t const ordinal = next_type_ordinal();
+	return ordinal;
+}
+
+//! Human-readable version of \p name, as given by std::type_info::name.
+inline std::string demangle(char const* name)
+{
+#if defined(__GNUG__)
+	int status = 0;
+	std::unique_ptr<char, void (*)(void*)> const demangled(abi::__cxa_demangle(name, nullptr, nullptr, &status), std::free);
+	if(status == 0)
+	{
+		return demangled.get();
+	}
+#endif
+
+	return name;
+}
+
+//! \p s with its quotes and backslashes escaped, to be written within a quoted JSON or DOT string.
+inline std::string escaped(std::string s)
+{
+	for(auto i = s.find_first_of("\"\\"); i != std::string::npos; i = s.find_first_of("\"\\", i + 2))
+	{
+		s.insert(i, 1, '\\');
+	}
+	return s;
+}
+
+//! CPU time consumed by the calling thread, in nanoseconds. Always 0 where unsupported.
+inline std::uint64_t thread_cpu_time()
+{
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return std::uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#else
+	return 0;
+#endif
+}
+
+//! Running totals of a handler's invocations. See \ref handler_profile.
+//!
+//! Only touched while \ref channel::dispatchers_m_ is locked, by the dispatching thread or the threads it waits on.
+struct handler_stats
+{
+	std::uint64_t invocations = 0, total = 0, max = 0, cpu = 0;
+
+	void record(std::uint64_t wall, std::uint64_t cpu_time)
+	{
+		++invocations;
+		total += wall;
+		max = std::max(max, wall);
+		cpu += cpu_time;
+	}
+};
+
+using event_type_index_t = std::type_index;	//!< Type by which to index an event.
+
+//! Convenience type alias.
+//!
+//! Since the type returned by std::make_tuple<Args...> may not be exactly std::tuple<Args...>,
+//! we use this type alias to ensure we're using the same type everywhere.
+template<typename... Args>
+using make_tuple_type_t = typename std::result_of<decltype(&std::make_tuple<Args...>)(Args...)>::type;
+
+//! Whether a \p T can be stored in a buffer of \p Size bytes rather than be allocated.
+template<typename T, std::size_t Size>
+inline constexpr bool fits_inline = sizeof(T) <= Size && alignof(T) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible<T>::value;
+
+//! Whether all of the parameters of event type \p Tuple are trivially copyable. std::tuple itself never is.
+template<typename Tuple>
+struct trivially_copyable_parameters;
+
+template<typename... Ts>
+struct trivially_copyable_parameters<std::tuple<Ts...>> : std::conjunction<std::is_trivially_copyable<Ts>...>
+{};
+
+//! What is known of an event type, across all channels. See \ref type_registry.
+//!
+//! Records are never destroyed and are chained together as they are first used.
+struct type_record
+{
+	std::type_info const& type;
+	std::size_t const size, alignment;
+	bool const trivially_copyable;
+	std::atomic<std::uint64_t> live{0}, constructed{0}, subscriptions{0};
+	type_record const* next = nullptr;
+
+	type_record(std::type_info const& type, std::size_t size, std::size_t alignment, bool trivially_copyable)
+		: type(type), size(size), alignment(alignment), trivially_copyable(trivially_copyable)
+	{}
+
+	//! The first of all records. Later ones come first.
+	static std::atomic<type_record const*>& head()
+	{
+		static std::atomic<type_record const*> head{nullptr};
+		return head;
+	}
+};
+
+//! The record of event type \p Tuple, created and chained on first use.
+template<typename Tuple>
+type_record& type_record_of()
+{
+	static type_record* const record = []
+		{
+			auto const record = new type_record(typeid(Tuple), sizeof(Tuple), alignof(Tuple), trivially_copyable_parameters<Tuple>::value);
+			record->next = type_record::head().load();
+			while(!type_record::head().compare_exchange_weak(record->next, record));
+			return record;
+		}();
+
+	return *record;
+}
+
+class events_t;
+
+//! What is recorded of an event sent while metrics are enabled. Ends the event's record.
+struct measurement_t
+{
+	type_metrics* metrics;		//!< Where to record the event's metrics.
+	clock_t::time_point sent;	//!< When the event was sent.
+};
+
+//! An event. Heads a record in an \ref events_t, followed by its payload: a std::tuple of parameters.
+//!
+//! Plays the role std::any used to, minus the hard-wired use of the global allocator and the uniform size.
+//! It can also be a non-owning \ref view of a single parameter, in which case it is not stored in an \ref events_t.
+class event_t
+{
+	friend class events_t;
+
+	std::type_info const* type_;
+	void const* payload_;			//!< What handlers are given. A std::tuple of parameters or, if \ref bare_, a lone parameter.
+	void (*destroy_)(event_t&);		//!< Destroys the object following this header in its record, if any and not yet destroyed.
+	std::uint32_t size_;			//!< Size of the whole record, header included.
+	bool bare_;
+	bool measured_;					//!< Whether the record ends with a \ref measurement_t.
+
+	event_t(std::type_info const& type, void const* payload, void (*destroy)(event_t&), std::size_t size, bool bare, bool measured)
+		: type_(&type), payload_(payload), destroy_(destroy), size_(static_cast<std::uint32_t>(size)), bare_(bare), measured_(measured)
+	{}
+
+	measurement_t const& measurement() const
+	{
+		return *std::launder(reinterpret_cast<measurement_t const*>(reinterpret_cast<unsigned char const*>(this) + size_ - sizeof(measurement_t)));
+	}
+
+public:
+	event_t(event_t const&) = delete;
+	event_t& operator=(event_t const&) = delete;
+
+	//! Makes a non-owning event out of a single parameter.
+	//!
+	//! It is indistinguishable from an event made from a copy of \p t but \p t must outlive it.
+	template<typename T>
+	static event_t view(T const& t)
+	{
+		return event_t(typeid(make_tuple_type_t<T const&>), &t, nullptr, 0, true, false);
+	}
+
+	//! The type of the payload, akin to std::any::type.
+	std::type_info const& type() const
+	{
+		return *type_;
+	}
+
+	//! Whether the payload is a lone parameter rather than a std::tuple.
+	bool bare() const
+	{
+		return bare_;
+	}
+
+	//! Where to record this event's metrics. \c nullptr if they are disabled.
+	type_metrics* metrics() const
+	{
+		return measured_ ? measurement().metrics : nullptr;
+	}
+
+	//! When this event was sent, if metrics are enabled.
+	clock_t::time_point sent() const
+	{
+		return measured_ ? measurement().sent : clock_t::time_point();
+	}
+
+	//! The payload, akin to std::any_cast.
+	template<typename T>
+	T const& get() const
+	{
+		return *static_cast<T const*>(payload_);
+	}
+};
+
+std::size_t const chunk_size = 64 * 1024;	//!< Events are stored in chunks of this many bytes, unless a single one is larger.
+std::size_t const chunk_alignment = 64;		//!< Alignment of chunks, hence the maximum alignment of event parameters.
+
+//! A queue of events of varying sizes, stored back to back.
+//!
+//! Each record is an \ref event_t header immediately followed by the event's payload, constructed in place.
+//! Records are laid out contiguously in chunks obtained from a std::pmr::memory_resource.
+//! Chunks are kept, rather than freed, when the queue is cleared so that the queue can be refilled without allocating.
+class events_t
+{
+	struct chunk_t
+	{
+		unsigned char* data;
+		std::size_t capacity, used;
+	};
+
+	std::pmr::memory_resource* resource_;
+	std::pmr::vector<chunk_t> chunks_;
+	std::size_t current_ = 0;	//!< Index of the chunk being filled.
+	std::size_t size_ = 0;		//!< Number of records.
+
+	static constexpr std::size_t align(std::size_t n, std::size_t alignment)
+	{
+		return (n + alignment - 1) / alignment * alignment;
+	}
+
+	//! Most bytes that may be needed between a record's header and a \p T to align the latter.
+	template<typename T>
+	static constexpr std::size_t padding = alignof(T) > alignof(event_t) ? alignof(T) - alignof(event_t) : 0;
+
+	//! Where the \p T of the record starting at \p record lies.
+	template<typename T>
+	static unsigned char* object_of(void* record)
+	{
+		return reinterpret_cast<unsigned char*>(align(reinterpret_cast<std::uintptr_t>(record) + sizeof(event_t), alignof(T)));
+	}
+
+	void add_chunk(std::size_t capacity)
+	{
+		chunks_.reserve(chunks_.size() + 1);
+		chunks_.push_back({static_cast<unsigned char*>(resource_->allocate(capacity, chunk_alignment)), capacity, 0});
+	}
+
+	//! Finds room for a record of \p bytes at the end of the queue.
+	unsigned char* allocate(std::size_t bytes)
+	{
+		for(; current_ != chunks_.size(); ++current_)
+		{
+			auto const& c = chunks_[current_];
+			if(c.capacity - c.used >= bytes)
+			{
+				return c.data + c.used;
+			}
+		}
+
+		add_chunk(std::max(bytes, chunk_size));
+		return chunks_[current_].data;
+	}
+
+	//! Constructs a record holding a \p T, viewed by handlers as a \p Tuple.
+	//!
+	//! If \p metrics isn't \c nullptr, the record ends with a \ref measurement_t stamped with the current time.
+	template<typename T, typename Tuple, typename... Args>
+	event_t& emplace(type_metrics* metrics, bool bare, Args&&... args)
+	{
+		static_assert(alignof(T) <= chunk_alignment, "Event parameters can't be aligned beyond detail::chunk_alignment.");
+		static_assert(alignof(measurement_t) <= alignof(event_t), "Measurements must be aligned as records end.");
+
+		auto const size = record_size<T>() + (metrics ? sizeof(measurement_t) : 0);
+		auto const p = allocate(size);
+		auto const object = new(object_of<T>(p)) T(std::forward<Args>(args)...);
+
+		auto& record = type_record_of<Tuple>();
+		record.live.fetch_add(1, std::memory_order_relaxed);
+		record.constructed.fetch_add(1, std::memory_order_relaxed);
+
+		auto const destroy = [](event_t& event)
+			{
+				std::launder(reinterpret_cast<T*>(object_of<T>(&event)))->~T();
+				type_record_of<Tuple>().live.fetch_sub(1, std::memory_order_relaxed);
+			};
+
+		auto const event = new(p) event_t(typeid(Tuple), payload_of(object), destroy, size, bare, metrics);
+		if(metrics)
+		{
+			new(p + record_size<T>()) measurement_t{metrics, clock_t::now()};
+		}
+
+		chunks_[current_].used += size;
+		++size_;
+
+		return *event;
+	}
+
+	//! A view along with the callable to release the memory it refers to.
+	template<typename View, typename Release>
+	struct borrowed_t
+	{
+		View view;
+		Release release;
+
+		template<typename R>
+		borrowed_t(View const& view, R&& release) : view(view), release(std::forward<R>(release))
+		{}
+
+		~borrowed_t()
+		{
+			release(std::as_const(view));
+		}
+	};
+
+	//! What handlers are given out of the object stored in a record.
+	template<typename T>
+	static void const* payload_of(T const* t)
+	{
+		return t;
+	}
+
+	template<typename View, typename Release>
+	static void const* payload_of(borrowed_t<View, Release> const* b)
+	{
+		return &b->view;
+	}
+
+public:
+	//! Bytes taken by a record holding a \p T, without a \ref measurement_t.
+	template<typename T>
+	static constexpr std::size_t record_size()
+	{
+		return align(sizeof(event_t) + padding<T> + sizeof(T), alignof(event_t));
+	}
+
+	class const_iterator
+	{
+		chunk_t const* chunk_;
+		chunk_t const* end_;
+		std::size_t offset_;
+
+		void skip_exhausted_chunks()
+		{
+			while(chunk_ != end_ && offset_ == chunk_->used)
+			{
+				++chunk_;
+				offset_ = 0;
+			}
+		}
+
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = event_t;
+		using difference_type = std::ptrdiff_t;
+		using pointer = event_t const*;
+		using reference = event_t const&;
+
+		const_iterator(chunk_t const* chunk, chunk_t const* end) : chunk_(chunk), end_(end), offset_(0)
+		{
+			skip_exhausted_chunks();
+		}
+
+		reference operator*() const
+		{
+			return *std::launder(reinterpret_cast<event_t const*>(chunk_->data + offset_));
+		}
+
+		pointer operator->() const
+		{
+			return &**this;
+		}
+
+		const_iterator& operator++()
+		{
+			offset_ += (*this)->size_;
+			skip_exhausted_chunks();
+			return *this;
+		}
+
+		const_iterator operator++(int)
+		{
+			auto i = *this;
+			++*this;
+			return i;
+		}
+
+		bool operator==(const_iterator const& other) const
+		{
+			return chunk_ == other.chunk_ && offset_ == other.offset_;
+		}
+
+		bool operator!=(const_iterator const& other) const
+		{
+			return !(*this == other);
+		}
+	};
+
+	explicit events_t(std::pmr::memory_resource* resource) : resource_(resource), chunks_(resource)
+	{}
+
+	events_t(events_t const&) = delete;
+	events_t& operator=(events_t const&) = delete;
+
+	~events_t()
+	{
+		clear();
+
+		for(auto const& c : chunks_)
+		{
+			resource_->deallocate(c.data, c.capacity, chunk_alignment);
+		}
+	}
+
+	//! Constructs an event out of \p args at the end of the queue.
+	//!
+	//! \param metrics Where to record the event's metrics. \c nullptr if they are disabled.
+	template<typename... Args>
+	event_t& emplace_back(type_metrics* metrics, Args&&... args)
+	{
+		using tuple_t = make_tuple_type_t<Args...>;
+		return emplace<tuple_t, tuple_t>(metrics, false, std::forward<Args>(args)...);
+	}
+
+	//! Constructs an event out of a single parameter that refers to memory owned by someone else.
+	//!
+	//! It is indistinguishable from an event made from a copy of \p view but calls \p release(view) when destroyed.
+	//! \param metrics Where to record the event's metrics. \c nullptr if they are disabled.
+	template<typename View, typename Release>
+	event_t& borrow_back(type_metrics* metrics, View const& view, Release&& release)
+	{
+		static_assert(std::is_nothrow_copy_constructible<View>::value, "Views must be cheap, non-throwing, copies.");
+
+		return emplace<borrowed_t<View, std::decay_t<Release>>, make_tuple_type_t<View const&>>(metrics, true, view, std::forward<Release>(release));
+	}
+
+	//! Destroys \p event ahead of the others, e.g. as soon as it has been dispatched. Its record stays in place until \ref clear.
+	void destroy(event_t const& event)
+	{
+		auto& e = const_cast<event_t&>(event);
+		if(auto const destroy = std::exchange(e.destroy_, nullptr))
+		{
+			destroy(e);
+		}
+	}
+
+	//! Destroys all events but keeps the chunks they were stored in.
+	void clear()
+	{
+		for(auto i = begin(); i != end(); )
+		{
+			destroy(*i++);
+		}
+
+		for(auto& c : chunks_)
+		{
+			c.used = 0;
+		}
+		current_ = 0;
+		size_ = 0;
+	}
+
+	void swap(events_t& other) noexcept
+	{
+		std::swap(resource_, other.resource_);
+		chunks_.swap(other.chunks_);
+		std::swap(current_, other.current_);
+		std::swap(size_, other.size_);
+	}
+
+	//! Adds chunks until the queue can hold \p bytes worth of records.
+	void reserve(std::size_t bytes)
+	{
+		auto const c = capacity();
+		if(c < bytes)
+		{
+			add_chunk(std::max(align(bytes - c, chunk_size), chunk_size));
+		}
+	}
+
+	//! Bytes worth of records the queue can hold without allocating.
+	std::size_t capacity() const
+	{
+		std::size_t capacity = 0;
+		for(auto const& c : chunks_)
+		{
+			capacity += c.capacity;
+		}
+		return capacity;
+	}
+
+	//! Touch the memory not yet used by records so that it doesn't page fault later.
+	void prefault()
+	{
+		for(auto const& c : chunks_)
+		{
+			volatile unsigned char* const p = c.data;
+			for(std::size_t i = c.used; i < c.capacity; i += 4096)
+			{
+				p[i] = 0;
+			}
+		}
+	}
+
+	bool empty() const
+	{
+		return size_ == 0;
+	}
+
+	std::size_t size() const
+	{
+		return size_;
+	}
+
+	const_iterator begin() const
+	{
+		return const_iterator(chunks_.data(), chunks_.data() + chunks_.size());
+	}
+
+	const_iterator end() const
+	{
+		return const_iterator(chunks_.data() + chunks_.size(), chunks_.data() + chunks_.size());
+	}
+};
+
+std::size_t const typical_record_size = events_t::record_size<void* [4]>();	//!< Bytes taken by the record of an event whose parameters add up to four pointers.
+
+//! Bytes taken by the record of an event of a given function signature.
+template<typename R, typename... Args>
+constexpr std::size_t record_size(R (*)(Args...))
+{
+	return events_t::record_size<make_tuple_type_t<Args...>>();
+}
+
+//! Convenience function to compute an event's \ref payload_size.
+template<class... Ts>
+static std::size_t event_size(std::tuple<Ts...> const& payload)
+{
+	return std::apply([](auto const&... ts)
+		{
+			return (std::size_t{0} + ... + payload_size<std::decay_t<decltype(ts)>>{}(ts));
+		}, payload);
+}
+
+//! Convenience function to get a type_index out of a \ref tuple_type_t<Args...>.
+template<typename... Args>
+static event_type_index_t event_type_index()
+{
+	return typeid(make_tuple_type_t<Args...>);
+}
+
+//! Convenience function to get a type_index out of a function signature, e.g. <tt>void (int, std::string)</tt>.
+template<typename R, typename... Args>
+static event_type_index_t event_type_index(R (*)(Args...))
+{
+	return event_type_index<Args...>();
+}
+
+std::size_t const stack_prefault_size = 64 * 1024;	//!< How much of its stack a thread touches when warming up.
+
+//! Touch the calling thread's stack so that it doesn't page fault later.
+inline void prefault_stack()
+{
+	unsigned char stack[stack_prefault_size];
+	volatile unsigned char* const p = stack;
+	for(std::size_t i = 0; i < stack_prefault_size; i += 4096)
+	{
+		p[i] = 0;
+	}
+}
+
+//! Convenience function to cast an event to a std::tuple of references to its parameters.
+//!
+//! Handlers are invoked with these references, sparing them a copy of the event.
+template<class... Args>
+static auto event_cast(event_t const& event)
+{
+	using tuple_t = make_tuple_type_t<Args...>;
+
+	if constexpr(sizeof...(Args) == 1)
+	{
+		if(event.bare())
+		{
+			return std::tie(event.template get<std::tuple_element_t<0, tuple_t>>());
+		}
+	}
+
+	return std::apply([](auto const&... ts){ return std::tie(ts...); }, event.template get<tuple_t>());
+}
+
+std::size_t const handler_inline_size = 4 * sizeof(void*);	//!< Callables up to this size are stored within the handler rather than allocated.
+
+//! An event handler. Owns a callable, stored inline or allocated from a std::pmr::memory_resource.
+//!
+//! The callable returns whether it is still alive, i.e. whether the subscriber it forwards to still exists.
+//! Plays the role std::function used to. Being allocator-aware, the containers it's stored in hand it their memory resource.
+class handler_t
+{
+	//! Type-specific operations on the callable.
+	struct operations_t
+	{
+		bool (*invoke)(void* f, event_t const& event);
+		void (*relocate)(void* from, void* to);							//!< Moves an inline callable to another handler's storage.
+		void* (*move_to)(void* f, std::pmr::memory_resource* resource);	//!< Moves an allocated callable to memory obtained from another memory resource.
+		void (*destroy)(void* f, bool allocated, std::pmr::memory_resource* resource);
+	};
+
+	template<typename F>
+	static operations_t const* operations()
+	{
+		static operations_t const o = {
+			[](void* f, event_t const& event)
+			{
+				return (*static_cast<F*>(f))(event);
+			},
+			[](void* from, void* to)
+			{
+				new(to) F(std::move(*static_cast<F*>(from)));
+				static_cast<F*>(from)->~F();
+			},
+			[](void* f, std::pmr::memory_resource* resource) -> void*
+			{
+				void* p = resource->allocate(sizeof(F), alignof(F));
+				return new(p) F(std::move(*static_cast<F*>(f)));
+			},
+			[](void* f, bool allocated, std::pmr::memory_resource* resource)
+			{
+				static_cast<F*>(f)->~F();
+				if(allocated)
+				{
+					resource->deallocate(f, sizeof(F), alignof(F));
+				}
+			}
+		};
+		return &o;
+	}
+
+	void* f_ = nullptr;
+	operations_t const* operations_ = nullptr;
+	std::pmr::memory_resource* resource_;
+	std::type_info const* target_type_ = &typeid(void);	//!< Type of the subscriber, for profiling.
+	handler_stats* stats_ = nullptr;						//!< Allocated from \ref resource_ while profiling.
+	alignas(std::max_align_t) unsigned char storage_[handler_inline_size];
+
+	bool allocated() const
+	{
+		return f_ != storage_;
+	}
+
+	void reset()
+	{
+		if(f_)
+		{
+			operations_->destroy(f_, allocated(), resource_);
+			f_ = nullptr;
+		}
+	}
+
+	void steal(handler_t& other)
+	{
+		target_type_ = other.target_type_;
+
+		if(other.stats_ && resource_->is_equal(*other.resource_))
+		{
+			std::swap(stats_, other.stats_);
+		}
+		else if(other.stats_)
+		{
+			profile(true);
+			*stats_ = *other.stats_;
+			other.profile(false);
+		}
+
+		if(!other.f_)
+		{
+			return;
+		}
+
+		operations_ = other.operations_;
+
+		if(!other.allocated())
+		{
+			operations_->relocate(other.f_, storage_);
+			f_ = storage_;
+			other.f_ = nullptr;
+		}
+		else if(resource_->is_equal(*other.resource_))
+		{
+			std::swap(f_, other.f_);
+		}
+		else
+		{
+			f_ = operations_->move_to(other.f_, resource_);
+		}
+	}
+
+public:
+	using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+	handler_t(allocator_type const& allocator = {}) : resource_(allocator.resource())
+	{}
+
+	handler_t(handler_t&& other) noexcept : resource_(other.resource_)
+	{
+		steal(other);
+	}
+
+	handler_t(handler_t&& other, allocator_type const& allocator) : resource_(allocator.resource())
+	{
+		steal(other);
+	}
+
+	handler_t& operator=(handler_t&& other)
+	{
+		if(this != &other)
+		{
+			reset();
+			profile(false);
+			steal(other);
+		}
+		return *this;
+	}
+
+	//! Stores a copy of \p f inline if it fits or else in memory obtained from this handler's memory resource.
+	template<typename F, typename = typename std::enable_if<!std::is_same<std::decay_t<F>, handler_t>::value>::type>
+	handler_t& operator=(F&& f)
+	{
+		using callable_t = std::decay_t<F>;
+
+		reset();
+
+		if constexpr(fits_inline<callable_t, handler_inline_size>)
+		{
+			f_ = new(storage_) callable_t(std::forward<F>(f));
+		}
+		else
+		{
+			void* p = resource_->allocate(sizeof(callable_t), alignof(callable_t));
+			try
+			{
+				f_ = new(p) callable_t(std::forward<F>(f));
+			}
+			catch(...)
+			{
+				resource_->deallocate(p, sizeof(callable_t), alignof(callable_t));
+				throw;
+			}
+		}
+
+		operations_ = operations<callable_t>();
+
+		return *this;
+	}
+
+	~handler_t()
+	{
+		reset();
+		profile(false);
+	}
+
+	//! Type of the subscriber this handler forwards to, akin to std::function::target_type.
+	std::type_info const& target_type() const
+	{
+		return *target_type_;
+	}
+
+	void target_type(std::type_info const& type)
+	{
+		target_type_ = &type;
+	}
+
+	//! Start or stop accounting for this handler's invocations. Stopping discards its \ref stats.
+	void profile(bool enable)
+	{
+		if(enable && !stats_)
+		{
+			stats_ = new(resource_->allocate(sizeof(handler_stats), alignof(handler_stats))) handler_stats;
+		}
+		else if(!enable && stats_)
+		{
+			resource_->deallocate(stats_, sizeof(handler_stats), alignof(handler_stats));
+			stats_ = nullptr;
+		}
+	}
+
+	//! Where to account for this handler's invocations. \c nullptr if it isn't profiled.
+	handler_stats* stats() const
+	{
+		return stats_;
+	}
+
+	//! \return Whether the handler is still alive. If not, it is meant to be discarded.
+	bool operator()(event_t const& event) const
+	{
+		return operations_->invoke(f_, event);
+	}
+};
+
+using tagged_handlers_t = std::pmr::map<handler_tag_t, handler_t>;			//!< Type of handlers key'ed by their tags.
+
+//! The tagged handlers of an event type.
+struct type_handlers_t : tagged_handlers_t
+{
+	using tagged_handlers_t::tagged_handlers_t;
+
+	bool pinned = false;	//!< Whether the entry is kept even when it holds no handler, as when made by \ref channel::warm_up.
+};
+
+using dispatchers_t = std::pmr::map<event_type_index_t, type_handlers_t>;	//!< Type of tagged handlers key'ed by event types.
+
+//! Release the entry of an event type if it no longer holds any handler and isn't pinned.
+//!
+//!\return The entry following \p i.
+inline dispatchers_t::iterator erase_if_empty(dispatchers_t& dispatchers, dispatchers_t::iterator i)
+{
+	return i->second.empty() && !i->second.pinned ? dispatchers.erase(i) : std::next(i);
+}
+
+//! What a handler being invoked on this thread is handling, while \ref flow_graph captures.
+struct handler_context
+{
+	handler_tag_t tag;
+	std::type_info const* input;
+	clock_t::time_point start;
+};
+
+//! The handler being invoked on this thread. \c nullptr if there is none or it isn't sampled.
+inline handler_context*& current_handler()
+{
+	thread_local handler_context* context = nullptr;
+	return context;
+}
+
+//! Whether this thread is invoking a handler, of any channel and whatever its dispatch policy.
+inline bool& invoking_handler()
+{
+	thread_local bool invoking = false;
+	return invoking;
+}
+
+}
+
+//! Captures which event types handlers send while handling which others, across all channels.
+//!
+//! Each edge of the graph goes from an event type, through the handler that handled it, to an event type it sent.
+//! Edges are recorded only for sends made from within a handler, on the thread invoking it, and only for sampled invocations.
+//! The graph can be written out as Graphviz or JSON, to reveal the topology of an application and amplification loops.
+class flow_graph
+{
+public:
+	//! An edge of the graph.
+	struct edge
+	{
+		handler_tag_t tag = 0;				//!< The handler.
+		std::string input;					//!< Demangled name of the event type it handled.
+		std::string output;					//!< Demangled name of the event type it sent.
+		std::uint64_t count = 0;			//!< Number of events sent in sampled invocations.
+		std::chrono::nanoseconds total{0};	//!< Sum of the time from the handler's invocation to each send.
+		std::chrono::nanoseconds max{0};	//!< Longest time from the handler's invocation to a send.
+	};
+
+	//! The process-wide graph.
+	static flow_graph& instance()
+	{
+		static flow_graph graph;
+		return graph;
+	}
+
+	//! Start capturing one in \p sample_every handler invocations per thread. 0 stops capturing.
+	void sample(unsigned sample_every = 1)
+	{
+		sample_every_.store(sample_every, std::memory_order_relaxed);
+	}
+
+	unsigned sampling() const
+	{
+		return sample_every_.load(std::memory_order_relaxed);
+	}
+
+	//! Records that the handler of \p context sent an event of type \p output.
+	void record(detail::handler_context const& context, std::type_info const& output)
+	{
+		auto const latency = std::chrono::duration_cast<std::chrono::nanoseconds>(detail::clock_t::now() - context.start);
+
+		std::lock_guard<std::mutex> lge(edges_m_);
+
+		auto& e = edges_[{context.tag, *context.input, output}];
+		++e.count;
+		e.total += latency;
+		e.max = std::max(e.max, latency);
+	}
+
+	//! Forgets all edges.
+	void clear()
+	{
+		std::lock_guard<std::mutex> lge(edges_m_);
+
+		edges_.clear();
+	}
+
+	std::vector<edge> edges()
+	{
+		std::lock_guard<std::mutex> lge(edges_m_);
+
+		std::vector<edge> edges;
+		for(auto const& e : edges_)
+		{
+			edges.push_back(e.second);
+			edges.back().tag = std::get<0>(e.first);
+			edges.back().input = detail::demangle(std::get<1>(e.first).name());
+			edges.back().output = detail::demangle(std::get<2>(e.first).name());
+		}
+
+		return edges;
+	}
+
+	//! Writes the graph in Graphviz's DOT language. Nodes are event types, edges are labelled with the handler's tag, count and mean latency.
+	void write_dot(std::ostream& os)
+	{
+		os << "digraph event_flow {\n";
+		for(auto const& e : edges())
+		{
+			os << "\t\"" << detail::escaped(e.input) << "\" -> \"" << detail::escaped(e.output) << "\" [label=\"" << e.tag << ": " << e.count << " x " << (e.total / e.count).count() << " ns\"];\n";
+		}
+		os << "}\n";
+	}
+
+	//! Writes the graph's edges as JSON.
+	void write_json(std::ostream& os)
+	{
+		char const* separator = "";
+		os << "{\"edges\":[";
+		for(auto const& e : edges())
+		{
+			os << separator << "{\"tag\":" << e.tag << ",\"input\":\"" << detail::escaped(e.input) << "\",\"output\":\"" << detail::escaped(e.output)
+			   << "\",\"count\":" << e.count << ",\"total_ns\":" << e.total.count() << ",\"max_ns\":" << e.max.count() << '}';
+			separator = ",";
+		}
+		os << "]}\n";
+	}
+
+private:
+	std::atomic<unsigned> sample_every_{0};
+
+	std::mutex edges_m_;
+	std::map<std::tuple<handler_tag_t, std::type_index, std::type_index>, edge> edges_;
+};
+
+//! What is known of an event type. See \ref type_registry.
+struct event_type_info
+{
+	std::type_index type = typeid(void);	//!< The event's type, a std::tuple of its parameters.
+	std::string name;						//!< Demangled name of \ref type.
+	std::size_t size = 0;					//!< sizeof the event's parameters, as stored in a channel's queue.
+	std::size_t alignment = 0;				//!< alignof the event's parameters.
+	bool trivially_copyable = false;		//!< Whether all of the event's parameters are trivially copyable.
+	std::uint64_t live = 0;					//!< Number of events constructed but not yet destroyed, i.e. queued or being dispatched.
+	std::uint64_t constructed = 0;			//!< Number of events ever constructed, not counting dropped ones.
+	std::uint64_t subscriptions = 0;		//!< Number of handlers ever subscribed.
+};
+
+//! Lists every event type sent or subscribed to, across all channels, since the process started.
+//!
+//! Types are recorded the first time they are sent or subscribed to and are never forgotten.
+//! Sizes help tune \ref detail::chunk_size and memory budgets, and spot event types that are expensive to copy.
+class type_registry
+{
+public:
+	//! Known event types, the most recently registered first.
+	static std::vector<event_type_info> types()
+	{
+		std::vector<event_type_info> types;
+		for(auto r = detail::type_record::head().load(); r; r = r->next)
+		{
+			types.push_back({r->type, detail::demangle(r->type.name()), r->size, r->alignment, r->trivially_copyable,
+							 r->live.load(std::memory_order_relaxed), r->constructed.load(std::memory_order_relaxed), r->subscriptions.load(std::memory_order_relaxed)});
+		}
+
+		return types;
+	}
+};
+
+//! Writes \p types as a table, one event type per line.
+inline std::ostream& operator<<(std::ostream& os, std::vector<event_type_info> const& types)
+{
+	os << "size\talignment\ttrivially copyable\tlive\tconstructed\tsubscriptions\tevent\n";
+	for(auto const& t : types)
+	{
+		os << t.size << '\t' << t.alignment << '\t' << (t.trivially_copyable ? "yes" : "no") << '\t' << t.live << '\t' << t.constructed << '\t' << t.subscriptions << '\t' << t.name << '\n';
+	}
+
+	return os;
+}
+
+namespace detail
+{
+
+//! Find the handlers of \p event, accounting for it in its metrics if they are enabled.
+inline dispatchers_t::iterator find_handlers(event_t const& event, dispatchers_t& dispatchers)
+{
+	auto const i = dispatchers.find(event.type());
+
+	if(auto const metrics = event.metrics())
+	{
+		if(i == dispatchers.end() || i->second.empty())
+		{
+			metrics->filtered.fetch_add(1, std::memory_order_relaxed);
+		}
+		else
+		{
+			metrics->dispatched.fetch_add(1, std::memory_order_relaxed);
+			metrics->latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_t::now() - event.sent()).count());
+		}
+	}
+
+	return i;
+}
+
+//! Invoke \p handler with \p event, timing it if metrics or profiling are enabled.
+//!
+//!\return Whether the handler is still alive.
+inline bool invoke(handler_t const& handler, event_t const& event)
+{
+	auto const metrics = event.metrics();
+	auto const stats = handler.stats();
+
+	if(!metrics && !stats)
+	{
+		return handler(event);
+	}
+
+	auto const cpu = stats ? thread_cpu_time() : 0;
+	auto const start = clock_t::now();
+	auto const alive = handler(event);
+	auto const wall = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_t::now() - start).count();
+
+	if(metrics)
+	{
+		metrics->handler_duration.record(wall);
+	}
+	if(stats)
+	{
+		stats->record(wall, thread_cpu_time() - cpu);
+	}
+
+	return alive;
+}
+
+//! Invoke \p handler, tagged \p tag, with \p event, between calls to \p InstrumentationPolicy's handler hooks.
+//!
+//! If the invocation is sampled by \ref flow_graph, the events the handler sends are recorded as coming from it.
+//!\return Whether the handler is still alive.
+template<class InstrumentationPolicy>
+bool invoke(handler_tag_t tag, handler_t const& handler, event_t const& event)
+{
+	struct end_t
+	{
+		handler_tag_t tag;
+		event_t const& event;
+		handler_context* previous;
+		bool invoking;
+
+		~end_t()
+		{
+			current_handler() = previous;
+			invoking_handler() = invoking;
+			InstrumentationPolicy::handler_end(event.type(), tag);
+		}
+	};
+
+	InstrumentationPolicy::handler_begin(event.type(), tag);
+	end_t const end{tag, event, current_handler(), std::exchange(invoking_handler(), true)};
+
+	if(auto const sample_every = flow_graph::instance().sampling())
+	{
+		thread_local unsigned invocations = 0;
+		if(++invocations % sample_every == 0)
+		{
+			handler_context context{tag, &event.type(), clock_t::now()};
+			current_handler() = &context;
+
+			return invoke(handler, event);
+		}
+	}
+
+	current_handler() = nullptr;
+	return invoke(handler, event);
+}
+
+//! Convenience function to map a function to a \ref handler_tag_t.
+template<typename R, typename... Args>
+handler_tag_t make_tag(R(*f)(Args...))
+{
+	return reinterpret_cast<handler_tag_t>(f);
+}
+
+//! Convenience function to map a member function to a \ref handler_tag_t.
+template<typename T, typename R, typename... Args>
+handler_tag_t make_tag(T* p, R(T::*f)(Args...))
+{
+	return reinterpret_cast<handler_tag_t>(p) + typeid(f).hash_code() * 37;
+}
+
+}
+
+namespace detail
+{
+
+//! Queue link and type-erased operations of an \ref intrusive_node.
+class intrusive_hook
+{
+	template<class DispatchPolicy, bool IdlePolicy, class InstrumentationPolicy>
+	friend class event_channel::channel;
+
+	intrusive_hook* next_ = nullptr;
+	event_t (*view_)(intrusive_hook&);		//!< Makes an event viewing the derived object.
+	void (*complete_)(intrusive_hook&);		//!< Hands the derived object back to its owner.
+
+protected:
+	intrusive_hook(decltype(view_) view, decltype(complete_) complete) : view_(view), complete_(complete)
+	{}
+
+	intrusive_hook(intrusive_hook const&) = delete;
+	intrusive_hook& operator=(intrusive_hook const&) = delete;
+};
+
+}
+
+//! Base class of events sent with \ref channel::send_intrusive.
+//!
+//! Embeds the link by which the channel queues the event so that sending it does not allocate.
+//! Handlers subscribe to \p T as if it were sent with \ref channel::send.
+//!
+//! \tparam T The derived type. That is, <tt>struct tick : intrusive_node<tick> {...};</tt>
+template<typename T>
+class intrusive_node : public detail::intrusive_hook
+{
+public:
+	using completion_t = void (*)(T&);	//!< Called once all handlers have returned, typically to return the node to a pool.
+
+	//! \param on_complete Called once the node has been handled or dropped. May be \c nullptr.
+	intrusive_node(completion_t on_complete = nullptr)
+		: intrusive_hook([](intrusive_hook& h)
+			{
+				return detail::event_t::view(static_cast<T const&>(static_cast<intrusive_node&>(h)));
+			},
+			[](intrusive_hook& h)
+			{
+				auto& n = static_cast<intrusive_node&>(h);
+				if(n.on_complete_)
+				{
+					n.on_complete_(static_cast<T&>(n));
+				}
+			}),
+		  on_complete_(on_complete)
+	{}
+
+private:
+	completion_t on_complete_;
+};
+
+//! A memory resource backed by 2 MiB huge pages, to spare TLB misses to channels holding many events.
+//!
+//! Allocations smaller than a huge page are carved out of huge pages shared with others, so that a channel's 64 KiB event chunks
+//! pack 32 to a page rather than each faulting in a page of its own. A shared page is given back once all of its allocations are.
+//! Larger allocations get huge pages of their own, rounded up to a whole number of them.
+//! It can be used directly or as the upstream resource of a pool, e.g.:
+//! \code
+//! event_channel::huge_page_resource huge_pages;
+//! std::pmr::synchronized_pool_resource pool(&huge_pages);
+//! event_channel::channel<> c(&pool);
+//! \endcode
+//!
+//! Memory is first sought from the kernel's huge page pool (\c MAP_HUGETLB), then as regular pages advised to be backed by transparent huge pages (\c MADV_HUGEPAGE).
+//! Where neither is available, allocations are forwarded to the upstream resource as they are, without rounding.
+class huge_page_resource : public std::pmr::memory_resource
+{
+public:
+	static std::size_t const page_size = 2 * 1024 * 1024;	//!< Size of a huge page.
+
+private:
+	std::pmr::memory_resource* upstream_;
+
+	std::atomic<std::size_t> huge_pages_{0},	//!< Number of allocations backed by the huge page pool.
+							 advised_{0},		//!< Number of allocations advised to be backed by transparent huge pages.
+							 forwarded_{0};		//!< Number of allocations forwarded upstream.
+
+	//! A huge page out of which allocations smaller than a page are carved.
+	struct shared_page_t
+	{
+		std::size_t used = 0;	//!< Bytes carved out so far.
+		std::size_t live = 0;	//!< Number of allocations not yet deallocated.
+		bool huge = false;		//!< Whether it is backed by the huge page pool rather than advised.
+	};
+
+	std::mutex m_;
+	std::map<std::uintptr_t, shared_page_t> shared_pages_;		//!< Keyed by their address.
+	std::uintptr_t current_ = 0;								//!< Address of the shared page being carved out. 0 if none.
+	std::map<void*, std::size_t> forwarded_allocations_;		//!< Sizes of the allocations forwarded upstream, to tell them apart from mapped ones when deallocating.
+
+	static std::size_t round_up(std::size_t bytes)
+	{
+		return (bytes + page_size - 1) / page_size * page_size;
+	}
+
+	//! Maps \p size bytes, a whole number of huge pages, aligned on a huge page boundary.
+	//!
+	//!\return The mapping, or \c nullptr if huge pages aren't available.
+	void* map(std::size_t size, bool& huge)
+	{
+#if defined(MAP_HUGETLB) || defined(MADV_HUGEPAGE)
+		void* p = MAP_FAILED;
+
+#if defined(MAP_HUGETLB)
+		p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if(p != MAP_FAILED)
+		{
+			huge = true;
+			return p;
+		}
+#endif
+
+#if defined(MADV_HUGEPAGE)
+		// Over-allocate so as to align on a huge page boundary, which transparent huge pages require.
+		p = mmap(nullptr, size + page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(p != MAP_FAILED)
+		{
+			auto const address = reinterpret_cast<std::uintptr_t>(p);
+			auto const aligned = (address + page_size - 1) / page_size * page_size;
+
+			if(aligned != address)
+			{
+				munmap(p, aligned - address);
+			}
+			munmap(reinterpret_cast<void*>(aligned + size), page_size - (aligned - address));
+
+			madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE);
+			huge = false;
+			return reinterpret_cast<void*>(aligned);
+		}
+#endif
+#else
+		(void)size;
+		(void)huge;
+#endif
+
+		return nullptr;
+	}
+
+	void unmap(void* p, std::size_t size)
+	{
+#if defined(MAP_HUGETLB) || defined(MADV_HUGEPAGE)
+		munmap(p, size);
+#else
+		(void)p;
+		(void)size;
+#endif
+	}
+
+	void count(bool huge)
+	{
+		++(huge ? huge_pages_ : advised_);
+	}
+
+	//! Carves \p bytes out of the current shared page, mapping a new one if it is too full.
+	//!
+	//! \ref m_ must be locked.
+	//!\return The allocation, or \c nullptr if huge pages aren't available.
+	void* carve(std::size_t bytes, std::size_t alignment)
+	{
+		if(current_)
+		{
+			auto& page = shared_pages_[current_];
+			auto const offset = (page.used + alignment - 1) / alignment * alignment;
+			if(offset + bytes <= page_size)
+			{
+				page.used = offset + bytes;
+				++page.live;
+				count(page.huge);
+				return reinterpret_cast<void*>(current_ + offset);
+			}
+
+			// Too full. It is given back once its last allocation is.
+			retire(current_);
+			current_ = 0;
+		}
+
+		bool huge = false;
+		void* const p = map(page_size, huge);
+		if(!p)
+		{
+			return nullptr;
+		}
+
+		current_ = reinterpret_cast<std::uintptr_t>(p);
+		auto& page = shared_pages_[current_];
+		page.used = bytes;
+		page.live = 1;
+		page.huge = huge;
+		count(huge);
+
+		return p;
+	}
+
+	//! Gives back the shared page at \p address if it is no longer carved out and has no allocation left.
+	//!
+	//! \ref m_ must be locked.
+	void retire(std::uintptr_t address)
+	{
+		auto const i = shared_pages_.find(address);
+		if(address != current_ && i->second.live == 0)
+		{
+			unmap(reinterpret_cast<void*>(address), page_size);
+			shared_pages_.erase(i);
+		}
+	}
+
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override
+	{
+		if(alignment <= page_size)
+		{
+			std::lock_guard<std::mutex> lgm(m_);
+
+			if(bytes < page_size)
+			{
+				if(void* const p = carve(bytes, alignment))
+				{
+					return p;
+				}
+			}
+			else
+			{
+				bool huge = false;
+				if(void* const p = map(round_up(bytes), huge))
+				{
+					count(huge);
+					return p;
+				}
+			}
+		}
+
+		void* const p = upstream_->allocate(bytes, alignment);
+		++forwarded_;
+
+		std::lock_guard<std::mutex> lgm(m_);
+		forwarded_allocations_.emplace(p, bytes);
+
+		return p;
+	}
+
+	void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+	{
+		{
+			std::lock_guard<std::mutex> lgm(m_);
+
+			auto const i = forwarded_allocations_.find(p);
+			if(i == forwarded_allocations_.end())
+			{
+				if(bytes < page_size)
+				{
+					// The shared page holding p is the last one starting at or before it.
+					auto const page = std::prev(shared_pages_.upper_bound(reinterpret_cast<std::uintptr_t>(p)));
+					--page->second.live;
+					retire(page->first);
+				}
+				else
+				{
+					unmap(p, round_up(bytes));
+				}
+				return;
+			}
+
+			bytes = i->second;
+			forwarded_allocations_.erase(i);
+		}
+
+		upstream_->deallocate(p, bytes, alignment);
+	}
+
+	bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override
+	{
+		return this == &other;
+	}
+
+public:
+	//! \param upstream Where to allocate from when huge pages aren't available.
+	explicit huge_page_resource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource()) : upstream_(upstream)
+	{}
+
+	huge_page_resource(huge_page_resource const&) = delete;
+	huge_page_resource& operator=(huge_page_resource const&) = delete;
+
+	~huge_page_resource()
+	{
+		for(auto const& page : shared_pages_)
+		{
+			unmap(reinterpret_cast<void*>(page.first), page_size);
+		}
+	}
+
+	//! Number of allocations backed by the huge page pool (\c MAP_HUGETLB).
+	std::size_t huge_page_allocations() const
+	{
+		return huge_pages_;
+	}
+
+	//! Number of allocations advised to be backed by transparent huge pages (\c MADV_HUGEPAGE).
+	std::size_t advised_allocations() const
+	{
+		return advised_;
+	}
+
+	//! Number of allocations forwarded to the upstream resource.
+	std::size_t upstream_allocations() const
+	{
+		return forwarded_;
+	}
+
+	//! Number of huge pages currently shared by allocations smaller than a page.
+	std::size_t shared_pages()
+	{
+		std::lock_guard<std::mutex> lgm(m_);
+
+		return shared_pages_.size();
+	}
+};
+
+//! Records what channels go through into per-thread ring buffers, to be written out as a Chrome trace.
+//!
+//! Fed by channels using \ref instrumentation_policy::trace, it records send instants, batch spans and handler spans.
+//! The result can be loaded in chrome://tracing or https://ui.perfetto.dev to see how they overlap across threads.
+//! Recording is off by default and costs an atomic load per hook while off.
+class trace_recorder
+{
+public:
+	static std::size_t const ring_size = 4 * 1024;	//!< Number of records kept per thread. Older ones are overwritten.
+
+	//! What a record marks.
+	enum class phase : char
+	{
+		send = 'i',			//!< An event was queued.
+		batch_begin = 'B',
+		batch_end = 'E',
+		handler_begin = 'b',
+		handler_end = 'e'
+	};
+
+	//! The process-wide recorder.
+	static trace_recorder& instance()
+	{
+		static trace_recorder recorder;
+		return recorder;
+	}
+
+	void enable(bool enable = true)
+	{
+		enabled_.store(enable, std::memory_order_relaxed);
+	}
+
+	bool enabled() const
+	{
+		return enabled_.load(std::memory_order_relaxed);
+	}
+
+	//! Records \p phase on the calling thread's ring buffer.
+	//!
+	//! \param type The event's type, if any.
+	//! \param value The batch's size or the handler's tag.
+	void record(phase phase, std::type_info const* type = nullptr, std::uint64_t value = 0)
+	{
+		if(!enabled())
+		{
+			return;
+		}
+
+		auto& ring = this_thread_ring();
+		auto const head = ring.head.load(std::memory_order_relaxed);
+		ring.records[head % ring_size] = {static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()), type, value, phase};
+		ring.head.store(head + 1, std::memory_order_release);
+	}
+
+	//! Discards all records.
+	void clear()
+	{
+		std::lock_guard<std::mutex> lgr(rings_m_);
+
+		for(auto const& ring : rings_)
+		{
+			ring->tail = ring->head.load(std::memory_order_acquire);
+		}
+	}
+
+	//! Writes the records in Chrome's trace event format.
+	//!
+	//! Records written while this runs may come out garbled. Disable recording first for a clean trace.
+	void write(std::ostream& os)
+	{
+		std::lock_guard<std::mutex> lgr(rings_m_);
+
+		char const* separator = "";
+		os << "{\"traceEvents\":[";
+		for(auto const& ring : rings_)
+		{
+			os << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->id << ",\"args\":{\"name\":\"thread " << ring->id << "\"}}";
+			separator = ",\n";
+
+			auto const head = ring->head.load(std::memory_order_acquire);
+			for(auto i = std::max(ring->tail, head > ring_size ? head - ring_size : 0); i != head; ++i)
+			{
+				auto const& r = ring->records[i % ring_size];
+
+				os << ",\n{\"pid\":1,\"tid\":" << ring->id << ",\"ts\":" << r.time / 1000 << '.' << (r.time % 1000) / 100 << (r.time % 100) / 10 << r.time % 10;
+				switch(r.phase)
+				{
+				case phase::send:
+					os << ",\"ph\":\"i\",\"s\":\"t\",\"cat\":\"send\",\"name\":\"" << detail::escaped(detail::demangle(r.type->name())) << '"';
+					break;
+				case phase::batch_begin:
+				case phase::batch_end:
+					os << ",\"ph\":\"" << static_cast<char>(r.phase) << "\",\"cat\":\"batch\",\"name\":\"batch\",\"args\":{\"size\":" << r.value << '}';
+					break;
+				case phase::handler_begin:
+				case phase::handler_end:
+					os << ",\"ph\":\"" << (r.phase == phase::handler_begin ? 'B' : 'E') << "\",\"cat\":\"handler\",\"name\":\"" << detail::escaped(detail::demangle(r.type->name())) << "\",\"args\":{\"tag\":" << r.value << '}';
+					break;
+				}
+				os << '}';
+			}
+		}
+		os << "]}\n";
+	}
+
+private:
+	struct record_t
+	{
+		std::uint64_t time;				//!< In nanoseconds.
+		std::type_info const* type;
+		std::uint64_t value;
+		trace_recorder::phase phase;
+	};
+
+	//! A thread's records. Written by that thread only.
+	struct ring_t
+	{
+		std::size_t id;
+		bool owned = true;					//!< Whether a thread writes to it. Guarded by \ref rings_m_.
+		std::atomic<std::uint64_t> head{0};	//!< Number of records ever written.
+		std::uint64_t tail = 0;				//!< Number of records ever written when last cleared.
+		std::array<record_t, ring_size> records;
+	};
+
+	std::atomic<bool> enabled_{false};
+
+	std::mutex rings_m_;
+	std::vector<std::unique_ptr<ring_t>> rings_;	//!< Outlive their threads so that their records can still be written out.
+
+	//! Hands its ring back to the recorder when its thread exits.
+	struct owner_t
+	{
+		trace_recorder* recorder = nullptr;
+		ring_t* ring = nullptr;
+
+		~owner_t()
+		{
+			if(ring)
+			{
+				std::lock_guard<std::mutex> lgr(recorder->rings_m_);
+				ring->owned = false;
+			}
+		}
+	};
+
+	//! The calling thread's ring.
+	//!
+	//! Rings of threads that have exited are reused rather than piling up, e.g. with the threads spawned by \ref dispatch_policy::parallel.
+	ring_t& this_thread_ring()
+	{
+		thread_local owner_t owner;
+
+		if(!owner.ring)
+		{
+			std::lock_guard<std::mutex> lgr(rings_m_);
+
+			auto const i = std::find_if(rings_.begin(), rings_.end(), [](auto const& ring){ return !ring->owned; });
+			if(i != rings_.end())
+			{
+				(*i)->owned = true;
+				owner.ring = i->get();
+			}
+			else
+			{
+				rings_.push_back(std::make_unique<ring_t>());
+				rings_.back()->id = rings_.size();
+				owner.ring = rings_.back().get();
+			}
+			owner.recorder = this;
+		}
+
+		return *owner.ring;
+	}
+};
+
+//! Set of instrumentation policies to use with \ref event_channel::channel.
+namespace instrumentation_policy
+{
+
+//! Policy class to use with \ref event_channel::channel.
+//! Does nothing and compiles away.
+//!
+//! Instrumentation policies are classes with the same static functions, called at these points of an event's life.
+//! They may be called while the channel holds one of its locks so they must be quick and must not call back into the channel.
+struct none
+{
+	//! Called on the sending thread once an event of type \p type has been queued.
+	static void enqueue(std::type_info const& /*type*/)
+	{}
+
+	//! Called on the dispatching thread before dispatching a batch of \p size events, not counting intrusive ones.
+	static void batch_begin(std::size_t /*size*/)
+	{}
+
+	//! Called before handler \p tag is invoked with an event of type \p type, on the thread invoking it.
+	static void handler_begin(std::type_info const& /*type*/, handler_tag_t /*tag*/)
+	{}
+
+	//! Called after handler \p tag has been invoked with an event of type \p type, on the thread having invoked it, even if it threw.
+	static void handler_end(std::type_info const& /*type*/, handler_tag_t /*tag*/)
+	{}
+
+	//! Called on the dispatching thread once a batch of \p size events has been dispatched and destroyed.
+	static void batch_end(std::size_t /*size*/)
+	{}
+};
+
+//! Policy class to use with \ref event_channel::channel.
+//! Records sends, batches and handler invocations with \ref trace_recorder, when it is enabled.
+struct trace
+{
+	static void enqueue(std::type_info const& type)
+	{
+		trace_recorder::instance().record(trace_recorder::phase::send, &type);
+	}
+
+	static void batch_begin(std::size_t size)
+	{
+		trace_recorder::instance().record(trace_recorder::phase::batch_begin, nullptr, size);
+	}
+
+	static void handler_begin(std::type_info const& type, handler_tag_t tag)
+	{
+		trace_recorder::instance().record(trace_recorder::phase::handler_begin, &type, tag);
+	}
+
+	static void handler_end(std::type_info const& type, handler_tag_t tag)
+	{
+		trace_recorder::instance().record(trace_recorder::phase::handler_end, &type, tag);
+	}
+
+	static void batch_end(std::size_t size)
+	{
+		trace_recorder::instance().record(trace_recorder::phase::batch_end, nullptr, size);
+	}
+};
+
+}
+
+//! Set of event dispatching policies to use with \ref event_channel::channel.
+namespace dispatch_policy
+{
+
+//! Policy class to use with \ref event_channel::channel.
+//! Serially invokes subscribed handlers for a given message.
+struct sequential
+{
+	//! Dispatches a single event.
+	//!
+	//! Handlers that are no longer alive are discarded, and so is their event type's entry if it is left empty and isn't pinned.
+	template<class InstrumentationPolicy = instrumentation_policy::none>
+	static void dispatch(detail::event_t const& event, detail::dispatchers_t& dispatchers)
+	{
+		auto const i = detail::find_handlers(event, dispatchers);
+		if(i == dispatchers.end())
+		{
+			return;
+		}
+
+		auto& handlers = i->second;
+		for(auto h = handlers.begin(); h != handlers.end();)
+		{
+			h = detail::invoke<InstrumentationPolicy>(h->first, h->second, event) ? std::next(h) : handlers.erase(h);
+		}
+
+		detail::erase_if_empty(dispatchers, i);
+	}
+
+	//! Dispatching function.
+	//!
+	//! Each event is destroyed as soon as it has been dispatched, rather than with the whole batch.
+	template<class InstrumentationPolicy = instrumentation_policy::none>
+	static void dispatch(detail::events_t& events, detail::dispatchers_t& dispatchers)
+	{
+		for(auto const& event : events)
+		{
+			dispatch<InstrumentationPolicy>(event, dispatchers);
+			events.destroy(event);
+		}
+	}
+};
+
+//! Policy class to use with \ref event_channel::channel.
+//! Invokes subscribed handlers in parallel for a given message.
+struct parallel
+{
+	//! Dispatches a single event.
+	//!
+	//! Handlers that are no longer alive are discarded, and so is their event type's entry if it is left empty and isn't pinned.
+	template<class InstrumentationPolicy = instrumentation_policy::none>
+	static void dispatch(detail::event_t const& event, detail::dispatchers_t& dispatchers)
+	{
+		auto const i = detail::find_handlers(event, dispatchers);
+		if(i == dispatchers.end())
+		{
+			return;
+		}
+
+		auto& handlers = i->second;
+
+		std::vector<std::pair<detail::tagged_handlers_t::iterator, std::future<bool>>> waiters;
+
+		for(auto h = handlers.begin(); h != handlers.end(); ++h)
+		{
+			waiters.emplace_back(h, std::async([&event, h]()
+				{
+					// As when merely waiting on the future, an exception thrown by a handler goes unnoticed.
+					try
+					{
+						return detail::invoke<InstrumentationPolicy>(h->first, h->second, event);
+					}
+					catch(...)
+					{
+						return true;
+					}
+				}));
+		}
+
+		for(auto& w : waiters)
+		{
+			if(!w.second.get())
+			{
+				handlers.erase(w.first);
+			}
+		}
+
+		detail::erase_if_empty(dispatchers, i);
+	}
+
+	//! Dispatching function.
+	//!
+	//! Each event is destroyed as soon as it has been dispatched, rather than with the whole batch.
+	template<class InstrumentationPolicy = instrumentation_policy::none>
+	static void dispatch(detail::events_t& events, detail::dispatchers_t& dispatchers)
+	{
+		for(auto const& event : events)
+		{
+			dispatch<InstrumentationPolicy>(event, dispatchers);
+			events.destroy(event);
+		}
+	}
+};
+
+}
+
+//! Set of idle policies to use with \ref event_channel::channel.
+namespace idle_policy
+{
+
+bool const keep_events = true;          //!< When stopped, retain unprocessed and incoming events.
+bool const drop_events = !keep_events;  //!< When stopped, drop unprocessed and incoming events.
+
+}
+
+//! Set of memory budget policies to use with \ref event_channel::channel::memory_budget.
+namespace budget_policy
+{
+
+bool const block = true;            //!< When over budget, block senders until enough events have been dispatched.
+bool const drop_events = !block;    //!< When over budget, drop incoming events.
+
+}
+
+//! To return a token to the subscribed event handler when calling \ref channel::subscribe, pass a \ref use_token as the first parameter.
+struct use_token{};
+
+//! Destroy the \ref token associated with an event handler's subscription to unsubscribe it.
+class [[no_discard]] token
+{
+	template<class DispatchPolicy, bool IdlePolicy, class InstrumentationPolicy>
+	friend class channel;
+	friend class metrics_registry;
+
+	std::function<void ()> f_ = []{};
+
+	token() {}
+	token(decltype(f_) f) : f_{f} {}
+
+public:
+	//! Convenience copy constructor.
+	token(token&& other)
+	{
+		std::swap(f_, other.f_);
+	}
+
+	//! Convenience assignment operator.
+	token& operator=(token&& other)
+	{
+		std::swap(f_, other.f_);
+		return *this;
+	}
+
+	~token()
+	{
+		f_();
+	}
+};
+
+namespace detail
+{
+
+//! A std::mutex that can account for its contention.
+//!
+//! Accounting is off by default, in which case locking costs an extra relaxed atomic load.
+class mutex
+{
+	std::mutex m_;
+
+	std::atomic<bool> enabled_{false};
+	std::atomic<std::uint64_t> acquisitions_{0}, contended_{0}, wait_{0}, max_hold_{0};
+
+	bool timed_ = false;				//!< Whether the current holder is being timed. Only touched by the holder.
+	clock_t::time_point acquired_;		//!< When the current holder took the lock. Only touched by the holder.
+
+	static std::uint64_t since(clock_t::time_point then)
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(clock_t::now() - then).count();
+	}
+
+	void acquired()
+	{
+		timed_ = enabled_.load(std::memory_order_relaxed);
+		if(timed_)
+		{
+			acquisitions_.fetch_add(1, std::memory_order_relaxed);
+			acquired_ = clock_t::now();
+		}
+	}
+
+	void releasing()
+	{
+		if(timed_)
+		{
+			auto const hold = since(acquired_);
+			auto max = max_hold_.load(std::memory_order_relaxed);
+			while(hold > max && !max_hold_.compare_exchange_weak(max, hold, std::memory_order_relaxed));
+		}
+	}
+
+	friend class condition_variable;
+
+public:
+	void lock()
+	{
+		if(!enabled_.load(std::memory_order_relaxed))
+		{
+			m_.lock();
+		}
+		else if(!m_.try_lock())
+		{
+			auto const start = clock_t::now();
+			m_.lock();
+			contended_.fetch_add(1, std::memory_order_relaxed);
+			wait_.fetch_add(since(start), std::memory_order_relaxed);
+		}
+
+		acquired();
+	}
+
+	bool try_lock()
+	{
+		if(!m_.try_lock())
+		{
+			return false;
+		}
+
+		acquired();
+		return true;
+	}
+
+	void unlock()
+	{
+		releasing();
+		m_.unlock();
+	}
+
+	void enable(bool enable)
+	{
+		enabled_.store(enable, std::memory_order_relaxed);
+	}
+
+	lock_stats stats() const
+	{
+		lock_stats s;
+		s.acquisitions = acquisitions_.load(std::memory_order_relaxed);
+		s.contended = contended_.load(std::memory_order_relaxed);
+		s.wait = std::chrono::nanoseconds(wait_.load(std::memory_order_relaxed));
+		s.max_hold = std::chrono::nanoseconds(max_hold_.load(std::memory_order_relaxed));
+		return s;
+	}
+};
+
+//! A std::condition_variable working with \ref mutex that can account for its wake-ups.
+class condition_variable
+{
+	std::condition_variable cv_;
+
+	std::atomic<std::uint64_t> wakeups_{0}, spurious_{0};
+
+public:
+	//! Waits until \p ready returns \c true.
+	template<typename Predicate>
+	void wait(std::unique_lock<mutex>& lock, Predicate ready)
+	{
+		auto& m = *lock.mutex();
+
+		for(auto woken = ready(); !woken;)
+		{
+			m.releasing();
+			{
+				std::unique_lock<std::mutex> native(m.m_, std::adopt_lock);
+				cv_.wait(native);
+				native.release();
+			}
+			m.acquired();
+
+			woken = ready();
+			if(m.timed_)
+			{
+				wakeups_.fetch_add(1, std::memory_order_relaxed);
+				spurious_.fetch_add(!woken, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	void notify_one()
+	{
+		cv_.notify_one();
+	}
+
+	void notify_all()
+	{
+		cv_.notify_all();
+	}
+
+	wakeup_stats stats() const
+	{
+		wakeup_stats s;
+		s.wakeups = wakeups_.load(std::memory_order_relaxed);
+		s.spurious = spurious_.load(std::memory_order_relaxed);
+		return s;
+	}
+};
+
+}
+
+//! The event channel. Handles subscriptions and message dispatching.
+//!
+//! \tparam DispatchPolicy How to dispatch events. A type from \ref dispatch_policy.
+//! \tparam IdlePolicy What to do with incoming events when idle. A value from idle_policy.
+//! \tparam InstrumentationPolicy Hooks called as events are sent and dispatched. A type from \ref instrumentation_policy.
+template<class DispatchPolicy = dispatch_policy::sequential, bool IdlePolicy = idle_policy::keep_events, class InstrumentationPolicy = instrumentation_policy::none>
+class channel
+{
+	detail::mutex dispatchers_m_, dispatchers_pending_m_, events_m_;
+	detail::condition_variable events_cv_, budget_cv_, warmed_up_cv_;
+	std::thread run_t_;
+
+	bool processing_;                           //!< Whether we are processing incoming events or not.
+	bool warming_up_;                           //!< Whether the dispatching thread is asked to \ref warm_up.
+	bool profiling_;                            //!< Whether handlers account for their invocations. Guarded by both \ref dispatchers_m_ and \ref dispatchers_pending_m_.
+	
+	unsigned long generic_handler_tagger_;      //!< The counter-style tag for \c Callable that can't be tracked otherwise.
+
+	std::pmr::memory_resource* resource_;       //!< Where events, subscribers and their containers are allocated from.
+
+	detail::events_t events_,    //!< Holds unprocessed events.
+					 batch_;     //!< Holds the events being dispatched. Only touched by the dispatching thread.
+
+	std::size_t reserved_;       //!< Capacity, in bytes, to which event buffers are grown ahead of time.
+
+	detail::intrusive_hook *intrusive_head_,     //!< Holds unprocessed intrusive events, linked through their hooks.
+						   *intrusive_tail_;
+	std::size_t intrusive_pending_;              //!< Number of events in the \ref intrusive_head_ list.
+
+	detail::clock_t::time_point queued_since_;   //!< When the oldest unprocessed event was queued.
+	batch_stats batches_;
+
+	//! A callback to call when the queue's lag crosses a threshold.
+	struct lag_watch_t
+	{
+		std::chrono::nanoseconds threshold;
+		std::function<void (std::chrono::nanoseconds, bool)> callback;
+		bool breached;
+	};
+	std::vector<lag_watch_t> lag_watches_;       //!< Guarded by \ref events_m_.
+
+	//! Whether no event is waiting to be taken by the dispatching thread.
+	//!
+	//! \ref events_m_ must be locked.
+	bool idle_queue() const
+	{
+		return events_.empty() && !intrusive_head_;
+	}
+
+	memory_stats memory_;        //!< Accounting of bytes held by \ref events_ and \ref batch_.
+	std::size_t events_bytes_,   //!< Bytes held by \ref events_.
+				batch_bytes_;    //!< Bytes held by \ref batch_.
+	bool budget_policy_;         //!< What to do with incoming events when over budget. A value from budget_policy.
+
+	bool metrics_enabled_;       //!< Whether events are counted and timed.
+	std::pmr::vector<std::unique_ptr<detail::type_metrics>> type_metrics_;   //!< Metrics of event types, indexed by \ref detail::type_ordinal.
+
+	//! Metrics of event type \p Tuple, created on first use. \c nullptr if metrics are disabled.
+	//!
+	//! \ref events_m_ must be locked.
+	template<typename Tuple>
+	detail::type_metrics* metrics_of()
+	{
+		if(!metrics_enabled_)
+		{
+			return nullptr;
+		}
+
+		auto const ordinal = detail::type_ordinal<Tuple>();
+		if(ordinal >= type_metrics_.size())
+		{
+			type_metrics_.resize(ordinal + 1);
+		}
+
+		auto& metrics = type_metrics_[ordinal];
+		if(!metrics)
+		{
+			metrics = std::make_unique<detail::type_metrics>(typeid(Tuple));
+		}
+
+		return metrics.get();
+	}
+
+	//! Give back the memory accounted for \p bytes and wake up senders blocked on the budget.
+	void release(std::size_t& bytes)
+	{
+		memory_.current -= bytes;
+		bytes = 0;
+
+		if(memory_.budget)
+		{
+			budget_cv_.notify_all();
+		}
+	}
+	
+	detail::dispatchers_t	dispatchers_pending_,   //!< Buffers subscribers.
+							dispatchers_;           //!< Holds subscribers.
+
+	//! Subscribe \p f, forwarding to a subscriber of type \p Target, as the handler tagged \p tag of events of type \p Tuple.
+	//!
+	//! \ref dispatchers_pending_m_ must be locked.
+	template<typename Target, typename Tuple, typename F>
+	void subscribe_pending(handler_tag_t tag, F&& f)
+	{
+		detail::type_record_of<Tuple>().subscriptions.fetch_add(1, std::memory_order_relaxed);
 
-using event_t = std::any;					//!< Event will be a std::any containing a std::tuple of parameters.
-using event_type_index_t = std::type_index;	//!< Type by which to index an event.
-using events_t = std::vector<event_t>;		//!< Type of a collection of events.
+		auto& handler = dispatchers_pending_[typeid(Tuple)][tag];
+		handler = std::forward<F>(f);
+		handler.target_type(typeid(Target));
+		handler.profile(profiling_);
+	}
 
-//! Convenience type alias.
-//!
-//! Since the type returned by std::make_tuple<Args...> may not be exactly std::tuple<Args...>,
-//! we use this type alias to ensure we're using the same type everywhere.
-template<typename... Args>
-using make_tuple_type_t = typename std::result_of<decltype(&std::make_tuple<Args...>)(Args...)>::type;
+	//! Move pending subscribers from \ref dispatchers_pending_ to \ref dispatchers_.
+	//!
+	//! Both \ref dispatchers_m_ and \ref dispatchers_pending_m_ must be locked.
+	void merge_pending()
+	{
+		for(auto& d : dispatchers_pending_)
+		{
+			dispatchers_[d.first].insert(std::make_move_iterator(d.second.begin()), std::make_move_iterator(d.second.end()));
+		}
+		dispatchers_pending_.clear();
+	}
 
-//! Convenience function to create an event out of parameters.
-template<class... Args>
-static event_t make_event(Args&&... args)
-{
-	return std::make_any<make_tuple_type_t<Args...>>(std::make_tuple(std::forward<Args>(args)...));
-}
+	//! Queue an event of \p size bytes, as computed by \ref payload_size, subject to the idle and budget policies.
+	//!
+	//! \param emplace Constructs the event in place at the end of the \ref detail::events_t it is given, measured with the \ref detail::type_metrics it is given, and returns it.
+	//! \return Whether the event was queued rather than dropped.
+	//! \tparam Tuple The event's type, for metrics.
+	template<typename Tuple, typename Emplace>
+	bool enqueue(std::size_t size, Emplace&& emplace)
+	{
+		// Registers the type even if none of its events is ever queued.
+		detail::type_record_of<Tuple>();
 
-//! Convenience function to get a type_index out of a \ref tuple_type_t<Args...>.
-template<typename... Args>
-static event_type_index_t event_type_index()
-{
-	return typeid(make_tuple_type_t<Args...>);
-}
+		std::unique_lock<detail::mutex> ule(events_m_);
 
-//! Convenience function to cast an event to it's underlying type of std::tuple.
-template<class... Args>
-static make_tuple_type_t<Args...> event_cast(event_t const& event)
-{
-	return std::any_cast<detail::make_tuple_type_t<Args...>>(event);
-}
+		auto const metrics = metrics_of<Tuple>();
+		if(metrics)
+		{
+			metrics->sent.fetch_add(1, std::memory_order_relaxed);
+		}
+		
+		if(processing_ || IdlePolicy == idle_policy::keep_events)
+		{
+			auto const over_budget = [&]{ return memory_.budget && memory_.current && memory_.current + size > memory_.budget; };
 
-using handler_t = std::function<void (event_t const&)>;					//!< Handlers are converted to this type.
-using tagged_handlers_t = std::map<handler_tag_t, handler_t>;			//!< Type of handlers key'ed by their tags.
-using dispatchers_t = std::map<event_type_index_t, tagged_handlers_t>;	//!< Type of tagged handlers key'ed by event types.
+			if(over_budget())
+			{
+				if(budget_policy_ == budget_policy::drop_events)
+				{
+					++memory_.dropped;
+					if(metrics)
+					{
+						metrics->dropped.fetch_add(1, std::memory_order_relaxed);
+					}
+					return false;
+				}
+				else if(!detail::invoking_handler())
+				{
+					budget_cv_.wait(ule, [&]{ return !over_budget(); });
+				}
+			}
 
-//! Convenience function to map a function to a \ref handler_tag_t.
-template<typename R, typename... Args>
-handler_tag_t make_tag(R(*f)(Args...))
-{
-	return reinterpret_cast<handler_tag_t>(f);
-}
+			if(idle_queue())
+			{
+				queued_since_ = detail::clock_t::now();
+			}
 
-//! Convenience function to map a member function to a \ref handler_tag_t.
-template<typename T, typename R, typename... Args>
-handler_tag_t make_tag(T* p, R(T::*f)(Args...))
-{
-	return reinterpret_cast<handler_tag_t>(p) + typeid(f).hash_code() * 37;
-}
+			auto& event = emplace(events_, metrics);
+			InstrumentationPolicy::enqueue(event.type());
+			events_bytes_ += size;
+			memory_.current += size;
+			memory_.peak = std::max(memory_.peak, memory_.current);
 
-}
+			ule.unlock();
+			events_cv_.notify_one();
 
-//! Set of event dispatching policies to use with \ref event_channel::channel.
-namespace dispatch_policy
-{
+			if(auto const context = detail::current_handler())
+			{
+				flow_graph::instance().record(*context, typeid(Tuple));
+			}
 
-//! Policy class to use with \ref event_channel::channel.
-//! Serially invokes subscribed handlers for a given message.
-struct sequential
-{
-	//! Dispatching function.
-	static void dispatch(detail::events_t const& events, detail::dispatchers_t const& dispatchers)
-	{
-		for(auto const& event : events)
+			return true;
+		}
+		else
 		{
-			for(auto const& dispatcher : dispatchers.at(event.type()))
+			++memory_.dropped;
+			if(metrics)
 			{
-				dispatcher.second(event);
+				metrics->dropped.fetch_add(1, std::memory_order_relaxed);
 			}
+
+			return false;
 		}
 	}
-};
 
-//! Policy class to use with \ref event_channel::channel.
-//! Invokes subscribed handlers in parallel for a given message.
-struct parallel
-{
-	//! Dispatching function.
-	static void dispatch(detail::events_t const& events, detail::dispatchers_t const& dispatchers)
+	//! Hand a list of intrusive events back to their owners without dispatching them.
+	static void complete(detail::intrusive_hook* node)
 	{
-		for(auto const& event : events)
+		while(node)
 		{
-			std::vector<std::future<void>> waiters;
+			auto const next = std::exchange(node->next_, nullptr);
+			node->complete_(*node);
+			node = next;
+		}
+	}
 
-			for(auto const& dispatcher : dispatchers.at(event.type()))
-			{
-				waiters.push_back(std::async([&](){ dispatcher.second(event); }));
-			}
+	void unsubscribe(detail::event_type_index_t const& index, handler_tag_t const& tag)
+	{
+		std::unique_lock<detail::mutex> uld(dispatchers_m_, std::defer_lock);
+		std::unique_lock<detail::mutex> uldp(dispatchers_pending_m_, std::defer_lock);
+		std::lock(uld, uldp);
 
-			for(auto& w : waiters)
+		// The handler may be in either map, even if both hold an entry for its event type, e.g. as pinned by \ref warm_up.
+		for(auto* dispatchers : {&dispatchers_, &dispatchers_pending_})
+		{
+			auto const i = dispatchers->find(index);
+			if(i != dispatchers->end())
 			{
-				w.wait();
+				i->second.erase(tag);
+				detail::erase_if_empty(*dispatchers, i);
 			}
 		}
 	}
-};
 
-}
+public:
+	//! \param resource The memory resource from which to allocate events, subscribers and the containers that hold them.
+	//! It is used concurrently by senders and by the dispatching thread and so must be thread-safe (e.g. std::pmr::synchronized_pool_resource).
+	explicit channel(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+		: processing_(false), warming_up_(false), profiling_(false), generic_handler_tagger_(0), resource_(resource), events_(resource), batch_(resource), reserved_(0), intrusive_head_(nullptr), intrusive_tail_(nullptr), intrusive_pending_(0), events_bytes_(0), batch_bytes_(0), budget_policy_(budget_policy::block), metrics_enabled_(false), type_metrics_(resource), dispatchers_pending_(resource), dispatchers_(resource)
+	{
+		start();
+	}
 
-//! Set of idle policies to use with \ref event_channel::channel.
-namespace idle_policy
-{
+	virtual ~channel()
+	{
+		stop();
 
-bool const keep_events = true;          //!< When stopped, retain unprocessed and incoming events.
-bool const drop_events = !keep_events;  //!< When stopped, drop unprocessed and incoming events.
+		// Kept intrusive events will never be dispatched but their owners still expect them back.
+		complete(intrusive_head_);
+	}
 
-}
+	//! The memory resource this channel allocates from.
+	std::pmr::memory_resource* resource() const
+	{
+		return resource_;
+	}
 
-//! To return a token to the subscribed event handler when calling \ref channel::subscribe, pass a \ref use_token as the first parameter.
-struct use_token{};
+	//! Pre-size the event buffers to hold \p n events, whose parameters add up to four pointers, without allocating.
+	//!
+	//! Buffers are recycled between senders and the dispatching thread so, once reserved, they don't shrink.
+	void reserve(std::size_t n)
+	{
+		std::lock_guard<detail::mutex> lge(events_m_);
 
-//! Destroy the \ref token associated with an event handler's subscription to unsubscribe it.
-class [[no_discard]] token
-{
-	template<class DispatchPolicy, bool IdlePolicy>
-	friend class channel;
+		reserved_ = n * detail::typical_record_size;
+		events_.reserve(reserved_);
+	}
 
-	std::function<void ()> f_ = []{};
+	//! Get ready for a burst of events so that the first ones don't incur one-time costs.
+	//!
+	//! Pending subscribers are made current, lookup entries are created for the expected event types,
+	//! event buffers are \ref reserve "reserved" and touched, and so is the dispatching thread's stack.
+	//! Returns once the dispatching thread is warmed up, if it is running.
+	//! As such, it must not be called from a handler: it would wait for the dispatching thread, itself waiting for the handler.
+	//!
+	//! The lookup entries are kept for the lifetime of the channel, even while no handler is subscribed to their event type.
+	//!
+	//! \tparam Signatures The expected event types, as function signatures. E.g. <tt>warm_up<void (int), void (std::string const&, double)>(1024)</tt>.
+	//! \param n Number of events to make room for.
+	template<typename... Signatures>
+	void warm_up(std::size_t n = 0)
+	{
+		{
+			std::unique_lock<detail::mutex> uld(dispatchers_m_, std::defer_lock);
+			std::unique_lock<detail::mutex> uldp(dispatchers_pending_m_, std::defer_lock);
+			std::lock(uld, uldp);
 
-	token() {}
-	token(decltype(f_) f) : f_{f} {}
+			merge_pending();
+			((dispatchers_[detail::event_type_index(static_cast<Signatures*>(nullptr))].pinned = true), ...);
+		}
 
-public:
-	//! Convenience copy constructor.
-	token(token&& other)
+		std::unique_lock<detail::mutex> ule(events_m_);
+
+		reserved_ = std::max(reserved_, n * std::max({detail::typical_record_size, detail::record_size(static_cast<Signatures*>(nullptr))...}));
+		events_.reserve(reserved_);
+		events_.prefault();
+
+		if(processing_)
+		{
+			warming_up_ = true;
+			events_cv_.notify_one();
+			warmed_up_cv_.wait(ule, [this]{ return !warming_up_ || !processing_; });
+		}
+	}
+
+	//! Set a limit on the bytes held by queued events, as computed by \ref payload_size.
+	//!
+	//! \param bytes The budget. 0 removes it.
+	//! \param policy What to do with events sent while over budget. A value from budget_policy.
+	//! Events sent from a handler, on whatever thread the dispatch policy invokes it, are never blocked since that would deadlock the dispatching thread.
+	//! An event is always accepted into an empty queue, however large it may be.
+	void memory_budget(std::size_t bytes, bool policy = budget_policy::block)
 	{
-		std::swap(f_, other.f_);
+		{
+			std::lock_guard<detail::mutex> lge(events_m_);
+
+			memory_.budget = bytes;
+			budget_policy_ = policy;
+		}
+
+		budget_cv_.notify_all();
 	}
 
-	//! Convenience assignment operator.
-	token& operator=(token&& other)
+	//! Current and peak bytes held by queued events.
+	memory_stats memory_usage()
 	{
-		std::swap(f_, other.f_);
-		return *this;
+		std::lock_guard<detail::mutex> lge(events_m_);
+
+		return memory_;
 	}
 
-	~token()
+	//! Start or stop counting and timing events, per event type. Disabled by default.
+	//!
+	//! Only events sent while metrics are enabled are accounted for. Intrusive events are not.
+	void enable_metrics(bool enable = true)
 	{
-		f_();
+		std::lock_guard<detail::mutex> lge(events_m_);
+
+		metrics_enabled_ = enable;
 	}
-};
 
-//! The event channel. Handles subscriptions and message dispatching.
-//!
-//! \tparam DispatchPolicy How to dispatch events. A type from \ref dispatch_policy.
-//! \tparam IdlePolicy What to do with incoming events when idle. A value from idle_policy.
-template<class DispatchPolicy = dispatch_policy::sequential, bool IdlePolicy = idle_policy::keep_events>
-class channel
-{
-	std::mutex dispatchers_m_, dispatchers_pending_m_, events_m_;
-	std::condition_variable events_cv_;
-	std::thread run_t_;
+	//! A snapshot of the metrics of every event type sent since metrics were first enabled.
+	//!
+	//! Cheap enough to be polled periodically: counters are read without stopping senders or the dispatching thread.
+	//! As such, they may be mutually inconsistent by the few events in flight while they are read.
+	std::vector<event_type_metrics> metrics()
+	{
+		// Event types' metrics live as long as the channel so only looking them up needs the lock, not snapshotting them.
+		std::vector<detail::type_metrics const*> type_metrics;
+		{
+			std::lock_guard<detail::mutex> lge(events_m_);
 
-	bool processing_;                           //!< Whether we are processing incoming events or not.
-	
-	unsigned long generic_handler_tagger_;      //!< The counter-style tag for \c Callable that can't be tracked otherwise.
+			for(auto const& metrics : type_metrics_)
+			{
+				if(metrics)
+				{
+					type_metrics.push_back(metrics.get());
+				}
+			}
+		}
 
-	detail::events_t events_;    //!< Holds unprocessed events.
-	
-	detail::dispatchers_t	dispatchers_pending_,   //!< Buffers subscribers.
-							dispatchers_;           //!< Holds subscribers.
+		std::vector<event_type_metrics> snapshot;
+		for(auto const* metrics : type_metrics)
+		{
+			event_type_metrics m;
+			m.type = metrics->type;
+			m.dropped = metrics->dropped.load(std::memory_order_relaxed);
+			m.filtered = metrics->filtered.load(std::memory_order_relaxed);
+			m.dispatched = metrics->dispatched.load(std::memory_order_relaxed);
+			m.sent = metrics->sent.load(std::memory_order_relaxed);
+			m.queue_depth = m.sent - std::min(m.sent, m.dispatched + m.filtered + m.dropped);
+			m.latency = metrics->latency.snapshot();
+			m.handler_duration = metrics->handler_duration.snapshot();
 
-	void unsubscribe(detail::event_type_index_t const& index, handler_tag_t const& tag)
+			snapshot.push_back(std::move(m));
+		}
+
+		return snapshot;
+	}
+
+	//! Start or stop accounting for every handler's invocations. Disabled by default.
+	//!
+	//! Stopping discards what was accounted for so far.
+	void enable_profiling(bool enable = true)
 	{
-		std::unique_lock<std::mutex> uld(dispatchers_m_, std::defer_lock);
-		std::unique_lock<std::mutex> uldp(dispatchers_pending_m_, std::defer_lock);
+		std::unique_lock<detail::mutex> uld(dispatchers_m_, std::defer_lock);
+		std::unique_lock<detail::mutex> uldp(dispatchers_pending_m_, std::defer_lock);
 		std::lock(uld, uldp);
 
-		detail::dispatchers_t::iterator i;
-		if((i = dispatchers_.find(index)) != dispatchers_.end())
+		profiling_ = enable;
+
+		for(auto* dispatchers : {&dispatchers_, &dispatchers_pending_})
 		{
-			i->second.erase(tag);
+			for(auto& d : *dispatchers)
+			{
+				for(auto& h : d.second)
+				{
+					h.second.profile(enable);
+				}
+			}
 		}
-		else if((i = dispatchers_pending_.find(index)) != dispatchers_pending_.end())
+	}
+
+	//! The \p n subscribed handlers that took the most wall time since profiling was enabled, slowest first.
+	//!
+	//! Waits for the batch of events being dispatched, if any.
+	std::vector<handler_profile> slowest_handlers(std::size_t n = 10)
+	{
+		std::vector<handler_profile> profiles;
+
 		{
-			i->second.erase(tag);
+			std::lock_guard<detail::mutex> lgd(dispatchers_m_);
+
+			for(auto const& d : dispatchers_)
+			{
+				for(auto const& h : d.second)
+				{
+					if(auto const stats = h.second.stats())
+					{
+						handler_profile p;
+						p.tag = h.first;
+						p.event_type = detail::demangle(d.first.name());
+						p.handler_type = detail::demangle(h.second.target_type().name());
+						p.invocations = stats->invocations;
+						p.total = std::chrono::nanoseconds(stats->total);
+						p.max = std::chrono::nanoseconds(stats->max);
+						p.cpu = std::chrono::nanoseconds(stats->cpu);
+
+						profiles.push_back(std::move(p));
+					}
+				}
+			}
 		}
+
+		auto const slowest = [](handler_profile const& a, handler_profile const& b){ return a.total > b.total; };
+		n = std::min(n, profiles.size());
+		std::partial_sort(profiles.begin(), profiles.begin() + n, profiles.end(), slowest);
+		profiles.resize(n);
+
+		return profiles;
 	}
 
-public:
-	channel() : processing_(false), generic_handler_tagger_(0)
+	//! Number of events queued and not yet taken by the dispatching thread.
+	std::size_t pending()
 	{
-		start();
+		std::lock_guard<detail::mutex> lge(events_m_);
+
+		return events_.size() + intrusive_pending_;
 	}
 
-	virtual ~channel()
+	//! How long the oldest event not yet taken by the dispatching thread has been queued. 0 if there is none.
+	std::chrono::nanoseconds oldest_age()
 	{
-		stop();
+		std::lock_guard<detail::mutex> lge(events_m_);
+
+		return idle_queue() ? std::chrono::nanoseconds(0) : std::chrono::duration_cast<std::chrono::nanoseconds>(detail::clock_t::now() - queued_since_);
+	}
+
+	//! Sizes of the batches of events dispatched so far.
+	batch_stats batch_sizes()
+	{
+		std::lock_guard<detail::mutex> lge(events_m_);
+
+		return batches_;
+	}
+
+	//! Have \p callback called when the queue's lag crosses \p threshold, either way.
+	//!
+	//! The lag is how long the oldest event of a batch waited to be dispatched.
+	//! It is evaluated by the dispatching thread as it takes each batch, so \p callback is called on that thread before the batch is dispatched.
+	//! None of the channel's locks is held meanwhile so \p callback may subscribe, unsubscribe or query the channel.
+	//! \param callback Called as <tt>callback(lag, breached)</tt> where \c breached tells whether \c lag is now at or above \p threshold.
+	void on_lag(std::chrono::nanoseconds threshold, std::function<void (std::chrono::nanoseconds lag, bool breached)> callback)
+	{
+		std::lock_guard<detail::mutex> lge(events_m_);
+
+		lag_watches_.push_back({threshold, std::move(callback), false});
+	}
+
+	//! Start or stop accounting for the contention of this channel's locks and condition variables. Disabled by default.
+	void enable_lock_stats(bool enable = true)
+	{
+		events_m_.enable(enable);
+		dispatchers_m_.enable(enable);
+		dispatchers_pending_m_.enable(enable);
+	}
+
+	//! Contention of this channel's locks and condition variables since \ref enable_lock_stats was called.
+	contention_stats lock_contention() const
+	{
+		contention_stats s;
+		s.events = events_m_.stats();
+		s.dispatchers = dispatchers_m_.stats();
+		s.dispatchers_pending = dispatchers_pending_m_.stats();
+		s.events_queued = events_cv_.stats();
+		s.budget = budget_cv_.stats();
+		s.warmed_up = warmed_up_cv_.stats();
+		return s;
 	}
 
 	//! Start dispatching events.
 	void start()
 	{
-		std::lock_guard<std::mutex> lge(events_m_);
+		std::lock_guard<detail::mutex> lge(events_m_);
 		
 		if(!processing_)
 		{
@@ -234,12 +2761,19 @@ public:
 			{
 				while(processing_)
 				{
-					detail::events_t events;
-					
+					detail::intrusive_hook* intrusive = nullptr;
+					std::size_t queued = 0;					// Number of events in this batch, intrusive ones included.
+					std::chrono::nanoseconds lag{0};		// How long the oldest of them waited.
+					std::vector<lag_watch_t> crossed;		// Watches whose threshold the lag crossed, to call once unlocked.
+
 					// Wait until we are told to stop processing events or until we have events to process.
 					{
-						std::unique_lock<std::mutex> ule(events_m_);
-						events_cv_.wait(ule, [this]{ return !processing_ || !events_.empty(); });
+						std::unique_lock<detail::mutex> ule(events_m_);
+
+						// The previous batch has been dispatched and its events destroyed.
+						release(batch_bytes_);
+
+						events_cv_.wait(ule, [this]{ return !processing_ || !events_.empty() || intrusive_head_ || warming_up_; });
 					
 						if(!processing_)
 						{
@@ -247,29 +2781,86 @@ public:
 						}
 						else
 						{
-							// Move pending events from \ref events_ to a local variable.
-							std::swap(events, events_);
+							if(warming_up_)
+							{
+								detail::prefault_stack();
+								batch_.reserve(reserved_);
+								batch_.prefault();
+
+								warming_up_ = false;
+								warmed_up_cv_.notify_all();
+							}
+
+							queued = events_.size() + intrusive_pending_;
+							if(queued)
+							{
+								lag = std::chrono::duration_cast<std::chrono::nanoseconds>(detail::clock_t::now() - queued_since_);
+
+								++batches_.batches;
+								batches_.events += queued;
+								batches_.max = std::max<std::uint64_t>(batches_.max, queued);
+								batches_.last = queued;
+
+								for(auto& watch : lag_watches_)
+								{
+									if((lag >= watch.threshold) != watch.breached)
+									{
+										watch.breached = !watch.breached;
+										crossed.push_back(watch);
+									}
+								}
+							}
+
+							// Move pending events from \ref events_ to \ref batch_.
+							// In exchange, senders get the previous batch's buffer which was cleared but kept its capacity.
+							batch_.swap(events_);
+							std::swap(batch_bytes_, events_bytes_);
+							intrusive = std::exchange(intrusive_head_, nullptr);
+							intrusive_tail_ = nullptr;
+							intrusive_pending_ = 0;
+
+							if(events_.capacity() < reserved_)
+							{
+								events_.reserve(reserved_);
+							}
 						}
 					}
+
+					for(auto const& watch : crossed)
+					{
+						watch.callback(lag, watch.breached);
+					}
 					
 					// Move pending subscribers from \ref dispatchers_pending_ to \ref dispatchers_.
 					// This allows users to add more subscribers while we process events.
 					// If we didn't do that, subscribing would block while events are processed since \ref dispatcher_ must remain intact while that happens.
 					// Mind you, as it is now, unsubscribing will still block while events are processed. To avoid this, we would need the equivalent of dispatcher_pending_ for removal.
-					std::unique_lock<std::mutex> uld(dispatchers_m_, std::defer_lock);
+					std::unique_lock<detail::mutex> uld(dispatchers_m_, std::defer_lock);
 					{
-						std::unique_lock<std::mutex> uldp(dispatchers_pending_m_, std::defer_lock);
+						std::unique_lock<detail::mutex> uldp(dispatchers_pending_m_, std::defer_lock);
 						std::lock(uld, uldp);
 						
-						for(auto& d : dispatchers_pending_)
-						{
-                            dispatchers_[d.first].insert(std::make_move_iterator(d.second.begin()), std::make_move_iterator(d.second.end()));
-						}
-						dispatchers_pending_.clear();
+						merge_pending();
 					}
-					
+
+					auto const size = batch_.size();
+					InstrumentationPolicy::batch_begin(size);
+
 					// Process events using given DispatchPolicy.
-					DispatchPolicy::dispatch(events, dispatchers_);
+					DispatchPolicy::template dispatch<InstrumentationPolicy>(batch_, dispatchers_);
+
+					while(intrusive)
+					{
+						auto const next = std::exchange(intrusive->next_, nullptr);
+						DispatchPolicy::template dispatch<InstrumentationPolicy>(intrusive->view_(*intrusive), dispatchers_);
+						intrusive->complete_(*intrusive);
+						intrusive = next;
+					}
+
+					// Destroy whatever events the dispatch policy left but keep the buffer's capacity for reuse.
+					batch_.clear();
+
+					InstrumentationPolicy::batch_end(size);
 				}
 			});
 	}
@@ -280,63 +2871,103 @@ public:
     //! The value of \p IdlePolicy will dictate what to do with incoming events in the meantime.
 	void stop()
 	{
+		detail::intrusive_hook* intrusive = nullptr;
+		detail::events_t dropped(resource_);		// Dropped events, destroyed once unlocked since that may call back into the channel.
+		std::size_t dropped_bytes = 0;
+
 		{
-			std::lock_guard<std::mutex> lge(events_m_);
+			std::lock_guard<detail::mutex> lge(events_m_);
 
 			if(IdlePolicy == idle_policy::drop_events)
 			{
-				events_.clear();
+				memory_.dropped += events_.size();
+				for(auto const& event : events_)
+				{
+					if(auto const metrics = event.metrics())
+					{
+						metrics->dropped.fetch_add(1, std::memory_order_relaxed);
+					}
+				}
+				dropped.swap(events_);
+				dropped_bytes = std::exchange(events_bytes_, 0);
+
+				intrusive = std::exchange(intrusive_head_, nullptr);
+				intrusive_tail_ = nullptr;
+				intrusive_pending_ = 0;
 			}
 
 			processing_ = false;
 		}
 
+		dropped.clear();
+
 		events_cv_.notify_one();
+		warmed_up_cv_.notify_all();
 		run_t_.join();
+
+		complete(intrusive);
+
+		std::lock_guard<detail::mutex> lge(events_m_);
+
+		if(IdlePolicy == idle_policy::drop_events)
+		{
+			// Senders drop events while stopped so the queue is still empty. Give it back its buffer, and its capacity.
+			events_.swap(dropped);
+			release(dropped_bytes);
+		}
+
+		// The dispatching thread may have returned before accounting for its last batch.
+		release(batch_bytes_);
 	}
 	
 	//! Suscribe a function as an event handler.
 	template<typename R, typename... Args>
 	void subscribe(R (*f)(Args...))
 	{
-		std::lock_guard<std::mutex> lge(dispatchers_pending_m_);
+		std::lock_guard<detail::mutex> lge(dispatchers_pending_m_);
 		
-		dispatchers_pending_[detail::event_type_index<Args...>()][detail::make_tag(f)] =
+		subscribe_pending<decltype(f), detail::make_tuple_type_t<Args...>>(detail::make_tag(f),
 			[f](detail::event_t const& event)
 			{
 				std::apply(f, detail::event_cast<Args...>(event));
-			};
+				return true;
+			});
 	}
 
 	//! Subscribe an object instance and a member function as an event handler.
 	template<typename T, typename R, typename... Args>
 	void subscribe(T* p, R (T::*f)(Args...))
 	{
-		std::lock_guard<std::mutex> lge(dispatchers_pending_m_);
+		std::lock_guard<detail::mutex> lge(dispatchers_pending_m_);
 		
-		dispatchers_pending_[detail::event_type_index<Args...>()][detail::make_tag(p, f)] =
+		subscribe_pending<decltype(f), detail::make_tuple_type_t<Args...>>(detail::make_tag(p, f),
 			[p, f](detail::event_t const& event)
 			{
 				std::apply(f, std::tuple_cat(std::tie(p), detail::event_cast<Args...>(event)));
-			};
+				return true;
+			});
 	}
 
 	//! Subscribe an object instance and a member function as an event handler.
 	//!
 	//! The \c weak_ptr<> is saved and invoked only if it can be locked.
+	//! The first time it can't, the subscription is discarded.
 	template<typename T, typename R, typename... Args>
 	void subscribe(std::shared_ptr<T> const& p, R (T::*f)(Args...))
 	{
-		std::lock_guard<std::mutex> lge(dispatchers_pending_m_);
+		std::lock_guard<detail::mutex> lge(dispatchers_pending_m_);
 		
-		dispatchers_pending_[detail::event_type_index<Args...>()][detail::make_tag(p.get(), f)] =
+		subscribe_pending<decltype(f), detail::make_tuple_type_t<Args...>>(detail::make_tag(p.get(), f),
 			[w = std::weak_ptr<T>(p), f](detail::event_t const& event)
 			{
 				if(auto const p = w.lock())
 				{
 					std::apply(f, std::tuple_cat(std::tie(p), detail::event_cast<Args...>(event)));
+					return true;
 				}
-			};
+
+				return false;
+			});
 	}
 
 	//! Subscribe a \c Callable as an event handler.
@@ -345,13 +2976,14 @@ public:
 	template<typename F, typename... Args>
 	handler_tag_t subscribe(F f, typename std::enable_if<std::is_invocable_v<F, Args...>, void**>::type = nullptr)
 	{
-		std::lock_guard<std::mutex> lge(dispatchers_pending_m_);
+		std::lock_guard<detail::mutex> lge(dispatchers_pending_m_);
 		
-		dispatchers_pending_[detail::event_type_index<Args...>()][generic_handler_tagger_] =
+		subscribe_pending<F, detail::make_tuple_type_t<Args...>>(generic_handler_tagger_,
 			[f](detail::event_t const& event)
 			{
 				std::apply(f, detail::event_cast<Args...>(event));
-			};
+				return true;
+			});
 		
 		return generic_handler_tagger_++;
 	};
@@ -408,17 +3040,19 @@ public:
 	//! Unsubscribe a previously subscribed \c Callable.
 	void unsubscribe(handler_tag_t tag)
 	{
-		std::unique_lock<std::mutex> uld(dispatchers_m_, std::defer_lock);
-		std::unique_lock<std::mutex> uldp(dispatchers_pending_m_, std::defer_lock);
+		std::unique_lock<detail::mutex> uld(dispatchers_m_, std::defer_lock);
+		std::unique_lock<detail::mutex> uldp(dispatchers_pending_m_, std::defer_lock);
 		std::lock(uld, uldp);
 
-		for(auto& d : dispatchers_)
+		for(auto i = dispatchers_.begin(); i != dispatchers_.end();)
 		{
-			d.second.erase(tag);
+			i->second.erase(tag);
+			i = detail::erase_if_empty(dispatchers_, i);
 		}
-		for(auto& d : dispatchers_pending_)
+		for(auto i = dispatchers_pending_.begin(); i != dispatchers_pending_.end();)
 		{
-			d.second.erase(tag);
+			i->second.erase(tag);
+			i = detail::erase_if_empty(dispatchers_pending_, i);
 		}
 	};
 
@@ -426,15 +3060,576 @@ public:
 	template<typename... Args>
 	void send(Args&&... args)
 	{
-		std::unique_lock<std::mutex> ule(events_m_);
-		
+		enqueue<detail::make_tuple_type_t<Args...>>(detail::event_size(std::tie(args...)), [&](detail::events_t& events, detail::type_metrics* metrics) -> detail::event_t&
+			{
+				return events.emplace_back(metrics, std::forward<Args>(args)...);
+			});
+	}
+
+	//! Send a non-owning view of a buffer (e.g. a std::string_view) without copying the buffer.
+	//!
+	//! Handlers subscribe to \p View as if it were sent with \ref send.
+	//! \param release Called with \p view once the event has been handled or dropped, to hand the buffer back to its owner.
+	//! When handled, that is on the dispatching thread as soon as the event's handlers have returned, before the rest of its batch is dispatched.
+	template<typename View, typename Release>
+	void send_borrowed(View const& view, Release&& release)
+	{
+		auto const queued = enqueue<detail::make_tuple_type_t<View const&>>(payload_size<View>{}(view), [&](detail::events_t& events, detail::type_metrics* metrics) -> detail::event_t&
+			{
+				return events.borrow_back(metrics, view, std::forward<Release>(release));
+			});
+
+		if(!queued)
+		{
+			release(view);
+		}
+	}
+
+	//! Send an event without allocating, linking it in the queue through its \ref intrusive_node hook.
+	//!
+	//! \p node must not be modified nor sent again until its completion callback is called.
+	//! Intrusive events are dispatched after the events sent with \ref send in the same batch, so their relative order is not preserved.
+	//! They are not accounted against the \ref memory_budget "memory budget".
+	template<typename T>
+	void send_intrusive(intrusive_node<T>& node)
+	{
+		detail::intrusive_hook& hook = node;
+
+		std::unique_lock<detail::mutex> ule(events_m_);
+
 		if(processing_ || IdlePolicy == idle_policy::keep_events)
 		{
-			events_.push_back(detail::make_event(args...));
+			if(idle_queue())
+			{
+				queued_since_ = detail::clock_t::now();
+			}
+
+			if(intrusive_tail_)
+			{
+				intrusive_tail_->next_ = &hook;
+			}
+			else
+			{
+				intrusive_head_ = &hook;
+			}
+			intrusive_tail_ = &hook;
+			++intrusive_pending_;
+			InstrumentationPolicy::enqueue(typeid(detail::make_tuple_type_t<T const&>));
+
 			ule.unlock();
 			events_cv_.notify_one();
+
+			if(auto const context = detail::current_handler())
+			{
+				flow_graph::instance().record(*context, typeid(detail::make_tuple_type_t<T const&>));
+			}
+		}
+		else
+		{
+			++memory_.dropped;
+			ule.unlock();
+
+			hook.complete_(hook);
+		}
+	}
+};
+
+//! Renders the statistics of registered channels as OpenMetrics (Prometheus) text.
+//!
+//! Statistics are gathered from each channel when rendered, so that registered channels pay nothing more than for their \ref channel::enable_metrics "metrics".
+//! \code
+//! event_channel::channel<> orders;
+//! orders.enable_metrics();
+//! auto const registration = event_channel::metrics_registry::instance().add("orders", orders);
+//! ...
+//! event_channel::metrics_registry::instance().write_file("/var/lib/node_exporter/event_channel.prom");
+//! \endcode
+class metrics_registry
+{
+	//! What is gathered from a channel.
+	struct snapshot_t
+	{
+		std::vector<event_type_metrics> event_types;
+		memory_stats memory;
+		std::size_t pending;
+		batch_stats batches;
+	};
+
+	struct entry_t
+	{
+		std::size_t id;
+		std::string name;
+		std::function<snapshot_t ()> snapshot;
+	};
+
+	std::mutex entries_m_;
+	std::vector<entry_t> entries_;
+	std::size_t next_id_ = 0;
+
+	//! Escapes \p value for use as a label value.
+	static std::string label(std::string const& value)
+	{
+		std::string escaped;
+		for(auto const c : value)
+		{
+			switch(c)
+			{
+			case '\\': escaped += "\\\\"; break;
+			case '"': escaped += "\\\""; break;
+			case '\n': escaped += "\\n"; break;
+			default: escaped += c;
+			}
+		}
+		return escaped;
+	}
+
+	//! Writes \p h as a histogram in seconds, with a bucket per power of two nanoseconds from 1.024 microseconds up.
+	static void write_histogram(std::ostream& os, char const* name, std::string const& labels, histogram::snapshot_t const& h)
+	{
+		std::uint64_t cumulative = 0;
+		std::size_t i = 0;
+		for(unsigned bits = 10; bits <= histogram::max_bits; ++bits)
+		{
+			auto const le = std::uint64_t{1} << bits;
+			for(; i != histogram::bucket_count && histogram::upper_bound(i) < le; ++i)
+			{
+				cumulative += h.counts[i];
+			}
+			os << name << "_bucket{" << labels << ",le=\"" << le * 1e-9 << "\"} " << cumulative << '\n';
+		}
+		os << name << "_bucket{" << labels << ",le=\"+Inf\"} " << h.count << '\n';
+		os << name << "_sum{" << labels << "} " << h.sum * 1e-9 << '\n';
+		os << name << "_count{" << labels << "} " << h.count << '\n';
+	}
+
+public:
+	//! The process-wide registry.
+	static metrics_registry& instance()
+	{
+		static metrics_registry registry;
+		return registry;
+	}
+
+	//! Registers \p channel under \p name.
+	//!
+	//!\return A \ref token to hold on to for as long as \p channel is to be rendered. Destroy it before \p channel.
+	template<class Channel>
+	token add(std::string const& name, Channel& channel)
+	{
+		std::lock_guard<std::mutex> lge(entries_m_);
+
+		auto const id = next_id_++;
+		entries_.push_back({id, name, [&channel]
+			{
+				return snapshot_t{channel.metrics(), channel.memory_usage(), channel.pending(), channel.batch_sizes()};
+			}});
+
+		return {[this, id]
+			{
+				std::lock_guard<std::mutex> lge(entries_m_);
+
+				entries_.erase(std::find_if(entries_.begin(), entries_.end(), [&](entry_t const& e){ return e.id == id; }));
+			}
+		};
+	}
+
+	//! Writes the statistics of all registered channels in the OpenMetrics text format.
+	void write(std::ostream& os)
+	{
+		std::vector<std::pair<std::string, snapshot_t>> snapshots;
+		{
+			std::lock_guard<std::mutex> lge(entries_m_);
+
+			for(auto const& e : entries_)
+			{
+				snapshots.emplace_back(label(e.name), e.snapshot());
+			}
+		}
+
+		auto const precision = os.precision(9);
+
+		auto const header = [&](char const* name, char const* type, char const* help)
+		{
+			os << "# TYPE " << name << ' ' << type << "\n# HELP " << name << ' ' << help << '\n';
+		};
+
+		auto const suffix = [](char const* type)
+		{
+			return std::string(type) == "counter" ? "_total" : "";
+		};
+
+		auto const per_channel = [&](char const* name, char const* type, char const* help, auto value)
+		{
+			header(name, type, help);
+			for(auto const& s : snapshots)
+			{
+				os << name << suffix(type) << "{channel=\"" << s.first << "\"} " << value(s.second) << '\n';
+			}
+		};
+
+		auto const per_event_type = [&](auto write_event_type)
+		{
+			for(auto const& s : snapshots)
+			{
+				for(auto const& m : s.second.event_types)
+				{
+					write_event_type("channel=\"" + s.first + "\",event=\"" + label(detail::demangle(m.type.name())) + '"', m);
+				}
+			}
+		};
+
+		auto const counter_or_gauge = [&](char const* name, char const* type, char const* help, auto value)
+		{
+			header(name, type, help);
+			per_event_type([&](std::string const& labels, event_type_metrics const& m)
+				{
+					os << name << suffix(type) << '{' << labels << "} " << value(m) << '\n';
+				});
+		};
+
+		auto const histograms = [&](char const* name, char const* help, auto value)
+		{
+			header(name, "histogram", help);
+			per_event_type([&](std::string const& labels, event_type_metrics const& m)
+				{
+					write_histogram(os, name, labels, value(m));
+				});
+		};
+
+		counter_or_gauge("event_channel_events_sent", "counter", "Events sent, whether they were queued or dropped.", [](auto const& m){ return m.sent; });
+		counter_or_gauge("event_channel_events_dispatched", "counter", "Events dispatched to at least one handler.", [](auto const& m){ return m.dispatched; });
+		counter_or_gauge("event_channel_events_dropped", "counter", "Events dropped when idle or over budget.", [](auto const& m){ return m.dropped; });
+		counter_or_gauge("event_channel_events_filtered", "counter", "Events sent while no handler was subscribed.", [](auto const& m){ return m.filtered; });
+		counter_or_gauge("event_channel_queue_depth", "gauge", "Events queued but not yet dispatched.", [](auto const& m){ return m.queue_depth; });
+		histograms("event_channel_latency_seconds", "Time from an event being sent to it being dispatched.", [](auto const& m) -> auto const& { return m.latency; });
+		histograms("event_channel_handler_duration_seconds", "Time spent in each handler invocation.", [](auto const& m) -> auto const& { return m.handler_duration; });
+
+		per_channel("event_channel_pending_events", "gauge", "Events not yet taken by the dispatching thread.", [](auto const& s){ return s.pending; });
+		per_channel("event_channel_memory_bytes", "gauge", "Bytes held by queued events.", [](auto const& s){ return s.memory.current; });
+		per_channel("event_channel_memory_peak_bytes", "gauge", "Highest number of bytes held by queued events.", [](auto const& s){ return s.memory.peak; });
+		per_channel("event_channel_memory_budget_bytes", "gauge", "Bytes allowed for queued events. 0 for no budget.", [](auto const& s){ return s.memory.budget; });
+		per_channel("event_channel_batches", "counter", "Batches of events dispatched.", [](auto const& s){ return s.batches.batches; });
+		per_channel("event_channel_batched_events", "counter", "Events in all batches dispatched.", [](auto const& s){ return s.batches.events; });
+
+		os << "# EOF\n";
+		os.precision(precision);
+	}
+
+	//! The statistics of all registered channels in the OpenMetrics text format.
+	std::string render()
+	{
+		std::ostringstream os;
+		write(os);
+		return os.str();
+	}
+
+	//! Writes the statistics of all registered channels in the OpenMetrics text format to \p path.
+	//!
+	//! The file is replaced at once so that it can be served while being updated.
+	//! \throws std::system_error if the file can't be written.
+	void write_file(std::string const& path)
+	{
+		auto const temporary = path + ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::trunc);
+			write(file);
+			if(!file.flush())
+			{
+				throw std::system_error(std::make_error_code(std::errc::io_error), "writing " + temporary);
+			}
+		}
+
+		if(std::rename(temporary.c_str(), path.c_str()) != 0)
+		{
+			throw std::system_error(errno, std::generic_category(), "renaming " + temporary + " to " + path);
+		}
+	}
+};
+
+#if defined(__unix__) || defined(__APPLE__)
+
+namespace detail
+{
+
+//! Layout of the shared memory segment written by \ref metrics_exporter and read by \ref metrics_reader.
+//!
+//! A \ref header followed by \ref header::capacity \ref event_type.
+//! Bump \ref version whenever it changes.
+namespace shm
+{
+
+std::uint32_t const magic = 0x4543484d;	//!< "ECHM".
+std::uint32_t const version = 1;
+std::size_t const name_size = 128;
+
+struct histogram
+{
+	std::uint64_t count, sum, max;
+	std::uint64_t counts[event_channel::histogram::bucket_count];
+};
+
+struct event_type
+{
+	char name[name_size];		//!< Demangled, truncated and null-terminated.
+	std::uint64_t sent, dispatched, dropped, filtered, queue_depth;
+	shm::histogram latency, handler_duration;
+};
+
+struct header
+{
+	std::uint32_t magic, version;
+	std::atomic<std::uint64_t> sequence;	//!< Odd while being written.
+	std::uint64_t time;						//!< When last published, in nanoseconds since the Unix epoch.
+	std::uint64_t capacity, count;			//!< Number of event types the segment holds and of those in use.
+	std::uint64_t memory_current, memory_peak, memory_budget, memory_dropped;
+	std::uint64_t pending;
+};
+
+inline std::size_t size(std::size_t capacity)
+{
+	return sizeof(header) + capacity * sizeof(event_type);
+}
+
+inline void copy(event_channel::histogram::snapshot_t const& from, shm::histogram& to)
+{
+	to.count = from.count;
+	to.sum = from.sum;
+	to.max = from.max;
+	std::copy(from.counts.begin(), from.counts.end(), to.counts);
+}
+
+inline void copy(shm::histogram const& from, event_channel::histogram::snapshot_t& to)
+{
+	to.count = from.count;
+	to.sum = from.sum;
+	to.max = from.max;
+	std::copy(std::begin(from.counts), std::end(from.counts), to.counts.begin());
+}
+
+//! POSIX shared memory objects are named "/something".
+inline std::string object_name(std::string const& name)
+{
+	return name.empty() || name.front() != '/' ? '/' + name : name;
+}
+
+}
+
+}
+
+//! Publishes a channel's metrics in a named shared memory segment, for a monitor to read from another process with \ref metrics_reader.
+//!
+//! Writes are guarded by a sequence lock so that readers never block the publishing process.
+//! Only available where POSIX shared memory is.
+class metrics_exporter
+{
+	std::string name_;
+	std::size_t capacity_;
+	detail::shm::header* header_;
+
+public:
+	//! Creates, or takes over, the segment named \p name.
+	//!
+	//! \param capacity Number of event types the segment can hold. Others aren't published.
+	//! \throws std::system_error if the segment can't be created.
+	explicit metrics_exporter(std::string const& name, std::size_t capacity = 64) : name_(detail::shm::object_name(name)), capacity_(capacity)
+	{
+		auto const fd = shm_open(name_.c_str(), O_CREAT | O_RDWR, 0644);
+		if(fd == -1)
+		{
+			throw std::system_error(errno, std::generic_category(), "shm_open " + name_);
+		}
+
+		auto const size = detail::shm::size(capacity_);
+		void* p = MAP_FAILED;
+		if(ftruncate(fd, size) == 0)
+		{
+			p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		}
+		auto const error = errno;
+		close(fd);
+
+		if(p == MAP_FAILED)
+		{
+			shm_unlink(name_.c_str());
+			throw std::system_error(error, std::generic_category(), "mmap " + name_);
+		}
+
+		header_ = new(p) detail::shm::header{};
+		header_->capacity = capacity_;
+		header_->version = detail::shm::version;
+		std::atomic_thread_fence(std::memory_order_release);
+		header_->magic = detail::shm::magic;
+	}
+
+	metrics_exporter(metrics_exporter const&) = delete;
+	metrics_exporter& operator=(metrics_exporter const&) = delete;
+
+	//! Removes the segment. Readers that have it opened can keep reading its last values.
+	~metrics_exporter()
+	{
+		munmap(header_, detail::shm::size(capacity_));
+		shm_unlink(name_.c_str());
+	}
+
+	//! Publishes \p channel's \ref channel::metrics "metrics", memory usage and number of pending events.
+	//!
+	//! Meant to be called periodically, e.g. every second, from any one thread.
+	template<class Channel>
+	void publish(Channel& channel)
+	{
+		auto const metrics = channel.metrics();
+		auto const memory = channel.memory_usage();
+		auto const pending = channel.pending();
+		auto const time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+		auto const sequence = header_->sequence.load(std::memory_order_relaxed);
+		header_->sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		header_->time = time;
+		header_->memory_current = memory.current;
+		header_->memory_peak = memory.peak;
+		header_->memory_budget = memory.budget;
+		header_->memory_dropped = memory.dropped;
+		header_->pending = pending;
+		header_->count = std::min(metrics.size(), capacity_);
+
+		auto* event_types = reinterpret_cast<detail::shm::event_type*>(header_ + 1);
+		for(std::size_t i = 0; i != header_->count; ++i)
+		{
+			auto const& m = metrics[i];
+			auto& e = event_types[i];
+
+			auto const name = detail::demangle(m.type.name());
+			auto const length = std::min(name.size(), detail::shm::name_size - 1);
+			std::copy(name.begin(), name.begin() + length, e.name);
+			e.name[length] = '\0';
+
+			e.sent = m.sent;
+			e.dispatched = m.dispatched;
+			e.dropped = m.dropped;
+			e.filtered = m.filtered;
+			e.queue_depth = m.queue_depth;
+			detail::shm::copy(m.latency, e.latency);
+			detail::shm::copy(m.handler_duration, e.handler_duration);
+		}
+
+		header_->sequence.store(sequence + 2, std::memory_order_release);
+	}
+};
+
+//! Metrics as published by a \ref metrics_exporter.
+struct published_metrics
+{
+	std::chrono::system_clock::time_point time;		//!< When they were published.
+	memory_stats memory;
+	std::size_t pending = 0;
+	std::vector<std::pair<std::string, event_type_metrics>> event_types;	//!< Keyed by demangled type name. Their \c type member is left unset since types don't cross processes.
+};
+
+//! Reads the metrics published by a \ref metrics_exporter, typically in another process.
+class metrics_reader
+{
+	std::size_t size_ = 0;
+	std::size_t capacity_;		//!< Number of event types the mapping holds, as the writer may change the header's own.
+	detail::shm::header const* header_;
+
+public:
+	//! Opens the segment named \p name.
+	//!
+	//! \throws std::system_error if there is no such segment.
+	//! \throws std::runtime_error if it isn't a metrics segment of this version.
+	explicit metrics_reader(std::string const& name)
+	{
+		auto const object_name = detail::shm::object_name(name);
+
+		auto const fd = shm_open(object_name.c_str(), O_RDONLY, 0);
+		if(fd == -1)
+		{
+			throw std::system_error(errno, std::generic_category(), "shm_open " + object_name);
+		}
+
+		struct stat st;
+		void* p = MAP_FAILED;
+		if(fstat(fd, &st) == 0 && std::size_t(st.st_size) >= sizeof(detail::shm::header))
+		{
+			size_ = st.st_size;
+			p = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+		}
+		auto const error = p == MAP_FAILED && size_ ? errno : EINVAL;
+		close(fd);
+
+		if(p == MAP_FAILED)
+		{
+			throw std::system_error(error, std::generic_category(), "mmap " + object_name);
+		}
+
+		header_ = static_cast<detail::shm::header const*>(p);
+
+		if(header_->magic != detail::shm::magic || header_->version != detail::shm::version || detail::shm::size(header_->capacity) > size_)
+		{
+			munmap(p, size_);
+			throw std::runtime_error(object_name + " is not an event channel metrics segment of version " + std::to_string(detail::shm::version));
+		}
+
+		capacity_ = (size_ - sizeof(detail::shm::header)) / sizeof(detail::shm::event_type);
+	}
+
+	metrics_reader(metrics_reader const&) = delete;
+	metrics_reader& operator=(metrics_reader const&) = delete;
+
+	~metrics_reader()
+	{
+		munmap(const_cast<detail::shm::header*>(header_), size_);
+	}
+
+	//! A consistent copy of the latest published metrics. Retries while they are being published.
+	published_metrics read() const
+	{
+		published_metrics metrics;
+		auto const* event_types = reinterpret_cast<detail::shm::event_type const*>(header_ + 1);
+
+		for(;;)
+		{
+			auto const sequence = header_->sequence.load(std::memory_order_acquire);
+			if(sequence % 2)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			metrics.time = std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(header_->time)));
+			metrics.memory.current = header_->memory_current;
+			metrics.memory.peak = header_->memory_peak;
+			metrics.memory.budget = header_->memory_budget;
+			metrics.memory.dropped = header_->memory_dropped;
+			metrics.pending = header_->pending;
+
+			metrics.event_types.resize(std::min<std::size_t>(header_->count, capacity_));
+			for(std::size_t i = 0; i != metrics.event_types.size(); ++i)
+			{
+				auto const& e = event_types[i];
+				auto& m = metrics.event_types[i];
+
+				m.first.assign(e.name, std::find(e.name, e.name + detail::shm::name_size, '\0'));
+				m.second.sent = e.sent;
+				m.second.dispatched = e.dispatched;
+				m.second.dropped = e.dropped;
+				m.second.filtered = e.filtered;
+				m.second.queue_depth = e.queue_depth;
+				detail::shm::copy(e.latency, m.second.latency);
+				detail::shm::copy(e.handler_duration, m.second.handler_duration);
+			}
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if(header_->sequence.load(std::memory_order_relaxed) == sequence)
+			{
+				return metrics;
+			}
 		}
 	}
 };
 
+#endif
+
 }
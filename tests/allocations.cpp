@@ -0,0 +1,228 @@
+#include "event_channel.h"
+
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+#include "semaphore.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+using namespace std;
+
+// Every allocation goes through these replacements of the global operator new.
+// They count allocations made while counting is on.
+namespace
+{
+
+atomic<bool> counting{false};
+atomic<size_t> allocations{0};
+
+void* allocate(size_t size)
+{
+	if(counting)
+	{
+		++allocations;
+	}
+
+	if(void* p = malloc(size ? size : 1))
+	{
+		return p;
+	}
+
+	throw bad_alloc();
+}
+
+void* allocate(size_t size, align_val_t alignment)
+{
+	if(counting)
+	{
+		++allocations;
+	}
+
+	auto const a = static_cast<size_t>(alignment);
+	if(void* p = aligned_alloc(a, (size + a - 1) / a * a))
+	{
+		return p;
+	}
+
+	throw bad_alloc();
+}
+
+}
+
+void* operator new(size_t size)
+{
+	return allocate(size);
+}
+
+void* operator new[](size_t size)
+{
+	return allocate(size);
+}
+
+void* operator new(size_t size, nothrow_t const&) noexcept
+{
+	try
+	{
+		return allocate(size);
+	}
+	catch(...)
+	{
+		return nullptr;
+	}
+}
+
+void* operator new[](size_t size, nothrow_t const&) noexcept
+{
+	try
+	{
+		return allocate(size);
+	}
+	catch(...)
+	{
+		return nullptr;
+	}
+}
+
+void* operator new(size_t size, align_val_t alignment)
+{
+	return allocate(size, alignment);
+}
+
+void* operator new[](size_t size, align_val_t alignment)
+{
+	return allocate(size, alignment);
+}
+
+void* operator new(size_t size, align_val_t alignment, nothrow_t const&) noexcept
+{
+	try
+	{
+		return allocate(size, alignment);
+	}
+	catch(...)
+	{
+		return nullptr;
+	}
+}
+
+void* operator new[](size_t size, align_val_t alignment, nothrow_t const&) noexcept
+{
+	try
+	{
+		return allocate(size, alignment);
+	}
+	catch(...)
+	{
+		return nullptr;
+	}
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, align_val_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, align_val_t) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t, align_val_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, size_t, align_val_t) noexcept
+{
+	free(p);
+}
+
+// Sends a warm-up round of events, or calls channel::warm_up, then fails if another round allocates anything.
+template<typename MessageType>
+void test(MessageType const message, unsigned short const message_count, bool const warm_up)
+{
+	event_channel::channel<event_channel::dispatch_policy::sequential> c;
+
+	semaphore* messages_acknowledged = nullptr;
+	size_t received = 0;
+
+	auto f = [&messages_acknowledged, &received](MessageType const&)
+	{
+		++received;
+		messages_acknowledged->signal();
+	};
+	c.template subscribe<decltype(f), MessageType const&>(f);
+
+	if(warm_up)
+	{
+		c.template warm_up<void (MessageType const&)>(message_count);
+	}
+	else
+	{
+		c.reserve(message_count);
+	}
+
+	for(int round = warm_up; round != 2; ++round)
+	{
+		semaphore s(1 - message_count);
+		messages_acknowledged = &s;
+
+		allocations = 0;
+		counting = round == 1;
+
+		for(unsigned short i = 0; i != message_count; ++i)
+		{
+			c.send(message);
+		}
+
+		s.wait();
+
+		counting = false;
+	}
+
+	REQUIRE(received == (2u - warm_up) * message_count);
+	REQUIRE(allocations == 0);
+}
+
+TEST_CASE("i_100", "")
+{
+	test<int>(22, 100, false);
+}
+
+TEST_CASE("s_100", "")
+{
+	test<string>("orange", 100, false);
+}
+
+TEST_CASE("i_100_warm_up", "")
+{
+	test<int>(22, 100, true);
+}
+
+TEST_CASE("s_100_warm_up", "")
+{
+	test<string>("orange", 100, true);
+}
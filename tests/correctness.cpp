@@ -4,8 +4,17 @@
 #include "catch.hpp"
 #include "semaphore.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <functional>
+#include <memory_resource>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <typeindex>
 
 using namespace std;
 
@@ -151,6 +160,1031 @@ TEST_CASE("listen_and_forget", "")
 
 }
 
+// Memory resource that counts the allocations it forwards upstream.
+class counting_resource : public pmr::memory_resource
+{
+	pmr::memory_resource* upstream_ = pmr::new_delete_resource();
+
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		++allocations;
+		allocated_bytes += bytes;
+		return upstream_->allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void* p, size_t bytes, size_t alignment) override
+	{
+		++deallocations;
+		upstream_->deallocate(p, bytes, alignment);
+	}
+
+	bool do_is_equal(const pmr::memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+
+public:
+	atomic<size_t> allocations{0}, deallocations{0}, allocated_bytes{0};
+};
+
+TEST_CASE("memory_resource", "")
+{
+	counting_resource resource;
+
+	{
+		semaphore message_received(0);
+
+		event_channel::channel<> c(&resource);
+		REQUIRE(c.resource() == &resource);
+
+		receiver<string> r(&message_received);
+		c.subscribe(&r, &receiver<string>::receive);
+
+		auto const subscribed = resource.allocations.load();
+		REQUIRE(subscribed != 0);
+
+		c.send(string("orange"));
+		message_received.wait();
+
+		REQUIRE(resource.allocations > subscribed);
+		REQUIRE(r.values() == vector<string>{"orange"});
+	}
+
+	REQUIRE(resource.allocations == resource.deallocations);
+}
+
+TEST_CASE("prune_expired", "")
+{
+	counting_resource resource;
+
+	semaphore message_received(0), ignored(0);
+
+	event_channel::channel<> c(&resource);
+
+	auto r = make_shared<receiver<int>>(&ignored);
+	c.subscribe(r, &receiver<int>::receive);
+
+	receiver<string> s(&message_received);
+	c.subscribe(&s, &receiver<string>::receive);
+
+	c.send(1);
+	c.send(string("orange"));
+	message_received.wait();
+
+	REQUIRE(r->values() == vector<int>{1});
+
+	// The subscriber dies. Its handler and its event type's entry are reclaimed the next time the event is dispatched.
+	r.reset();
+	auto const deallocations = resource.deallocations.load();
+
+	c.send(2);
+	c.send(string("orange"));
+	message_received.wait();
+
+	REQUIRE(resource.deallocations > deallocations);
+}
+
+TEST_CASE("reserve", "")
+{
+	unsigned short const message_count = 1000;
+
+	counting_resource resource;
+
+	semaphore first_acknowledged(0), messages_acknowledged(1 - message_count);
+	semaphore* acknowledged = &first_acknowledged;
+
+	event_channel::channel<> c(&resource);
+
+	vector<int> received;
+	auto f = [&](int i)
+	{
+		received.push_back(i);
+		acknowledged->signal();
+	};
+	c.subscribe<decltype(f), int>(f);
+
+	c.reserve(message_count);
+
+	// The first batch makes the subscriber current and hands the dispatching thread a buffer of its own.
+	c.send(-1);
+	first_acknowledged.wait();
+	acknowledged = &messages_acknowledged;
+
+	auto const allocations = resource.allocations.load();
+
+	for(unsigned short i = 0; i != message_count; ++i)
+	{
+		c.send(int(i));
+	}
+
+	messages_acknowledged.wait();
+
+	REQUIRE(resource.allocations == allocations);
+
+	REQUIRE(received.size() == message_count + 1);
+	for(unsigned short i = 0; i != message_count; ++i)
+	{
+		REQUIRE(received[i + 1] == i);
+	}
+}
+
+TEST_CASE("warm_up", "")
+{
+	counting_resource resource;
+
+	semaphore message_received(0);
+
+	event_channel::channel<> c(&resource);
+
+	receiver<string> r(&message_received);
+	c.subscribe(&r, &receiver<string>::receive);
+
+	c.warm_up<void (int), void (string)>(10);
+
+	auto const allocations = resource.allocations.load();
+	auto const deallocations = resource.deallocations.load();
+
+	// No one handles ints yet. Their entry must outlive their first event nonetheless.
+	c.send(1);
+	c.send(string("orange"));
+	message_received.wait();
+
+	REQUIRE(resource.allocations == allocations);
+	REQUIRE(resource.deallocations == deallocations);
+
+	// A handler still pending when unsubscribed is found even though its event type has a current entry.
+	receiver<int> i(&message_received);
+	c.subscribe(&i, &receiver<int>::receive);
+	c.unsubscribe(&i, &receiver<int>::receive);
+
+	c.send(2);
+	c.send(string("orange"));
+	message_received.wait();
+
+	REQUIRE(i.values().empty());
+}
+
+TEST_CASE("huge_page_resource", "")
+{
+	counting_resource upstream;
+
+	{
+		event_channel::huge_page_resource huge_pages(&upstream);
+
+		// Alignments beyond a huge page can't be mapped. Such allocations are forwarded upstream as they are.
+		auto const alignment = 2 * event_channel::huge_page_resource::page_size;
+		void* const p = huge_pages.allocate(64, alignment);
+		REQUIRE(huge_pages.upstream_allocations() == 1);
+		REQUIRE(upstream.allocated_bytes == 64);
+		huge_pages.deallocate(p, 64, alignment);
+		REQUIRE(upstream.deallocations == 1);
+
+		// Allocations smaller than a huge page share them, a page being given back once all of its allocations are.
+		size_t const chunk_size = 64 * 1024, per_page = event_channel::huge_page_resource::page_size / chunk_size;
+		vector<void*> chunks;
+		for(size_t i = 0; i != per_page + 1; ++i)
+		{
+			chunks.push_back(huge_pages.allocate(chunk_size, 64));
+		}
+		if(huge_pages.upstream_allocations() == 1)
+		{
+			REQUIRE(huge_pages.shared_pages() == 2);
+			REQUIRE(static_cast<char*>(chunks[1]) - static_cast<char*>(chunks[0]) == chunk_size);
+		}
+		for(auto const chunk : chunks)
+		{
+			huge_pages.deallocate(chunk, chunk_size, 64);
+		}
+		if(huge_pages.upstream_allocations() == 1)
+		{
+			// The page still being carved out is kept.
+			REQUIRE(huge_pages.shared_pages() == 1);
+		}
+
+		semaphore message_received(0);
+
+		pmr::synchronized_pool_resource pool(&huge_pages);
+		{
+			event_channel::channel<> c(&pool);
+
+			receiver<string> r(&message_received);
+			c.subscribe(&r, &receiver<string>::receive);
+
+			c.send(string("orange"));
+			message_received.wait();
+
+			REQUIRE(r.values() == vector<string>{"orange"});
+		}
+
+		REQUIRE(huge_pages.huge_page_allocations() + huge_pages.advised_allocations() + huge_pages.upstream_allocations() > 1);
+	}
+
+	REQUIRE(upstream.allocations == upstream.deallocations);
+}
+
+TEST_CASE("memory_budget", "")
+{
+	semaphore entered(0), proceed(0), done(1 - 3);
+
+	event_channel::channel<> c;
+	c.memory_budget(3 * sizeof(int), event_channel::budget_policy::drop_events);
+
+	auto f = [&](int)
+	{
+		entered.signal();
+		proceed.wait();
+		done.signal();
+	};
+	c.subscribe<decltype(f), int>(f);
+
+	// Hold the dispatching thread in the first event's handler while more events queue up.
+	c.send(1);
+	entered.wait();
+
+	c.send(2);
+	c.send(3);
+	c.send(4);	// Over budget, dropped.
+
+	auto usage = c.memory_usage();
+	REQUIRE(usage.current == 3 * sizeof(int));
+	REQUIRE(usage.peak == 3 * sizeof(int));
+	REQUIRE(usage.dropped == 1);
+
+	proceed.signal();
+	entered.wait();
+	proceed.signal();
+	entered.wait();
+	proceed.signal();
+	done.wait();
+
+	c.send(5);	// Back under budget.
+	entered.wait();
+	REQUIRE(c.memory_usage().dropped == 1);
+	proceed.signal();
+}
+
+TEST_CASE("memory_budget_parallel", "")
+{
+	semaphore done(1 - 3);
+
+	event_channel::channel<event_channel::dispatch_policy::parallel> c;
+	c.memory_budget(sizeof(int), event_channel::budget_policy::block);
+
+	// Handlers run on threads of their own but sending from them must not block while their event is held.
+	auto f = [&](int)
+	{
+		c.send(1.);
+		c.send(2.);
+		c.send(3.);
+	};
+	c.subscribe<decltype(f), int>(f);
+
+	auto g = [&](double){ done.signal(); };
+	c.subscribe<decltype(g), double>(g);
+
+	c.send(1);
+	done.wait();
+
+	REQUIRE(c.memory_usage().dropped == 0);
+}
+
+struct intrusive_message : event_channel::intrusive_node<intrusive_message>
+{
+	int value;
+	semaphore* completed;
+
+	intrusive_message(int value, semaphore* completed)
+		: intrusive_node([](intrusive_message& m){ m.completed->signal(); }), value(value), completed(completed)
+	{}
+};
+
+TEST_CASE("send_intrusive", "")
+{
+	semaphore completed(1 - 2);
+
+	event_channel::channel<> c;
+
+	vector<intrusive_message const*> received;
+	auto f = [&](intrusive_message const& m)
+	{
+		received.push_back(&m);
+	};
+	c.subscribe<decltype(f), intrusive_message const&>(f);
+
+	intrusive_message m1(1, &completed), m2(2, &completed);
+	c.send_intrusive(m1);
+	c.send_intrusive(m2);
+
+	completed.wait();
+
+	// Handlers were given the very nodes that were sent.
+	REQUIRE(received == (vector<intrusive_message const*>{&m1, &m2}));
+}
+
+TEST_CASE("send_borrowed", "")
+{
+	semaphore released(0);
+
+	event_channel::channel<> c;
+
+	char const buffer[] = "orange";
+
+	string_view received;
+	auto f = [&](string_view v)
+	{
+		received = v;
+	};
+	c.subscribe<decltype(f), string_view>(f);
+
+	bool release_after_handler = false;
+	c.send_borrowed(string_view(buffer), [&](string_view v)
+		{
+			release_after_handler = v.data() == buffer && received.data() == buffer;
+			released.signal();
+		});
+
+	released.wait();
+
+	// The handler was given a view of the very buffer that was sent.
+	REQUIRE(release_after_handler);
+
+	// Hold the dispatching thread while two borrowed events queue up in a same batch.
+	semaphore entered(0), proceed(0);
+	auto g = [&](int)
+	{
+		entered.signal();
+		proceed.wait();
+	};
+	c.subscribe<decltype(g), int>(g);
+
+	c.send(1);
+	entered.wait();
+
+	vector<string_view> released_views;
+	c.send_borrowed(string_view(buffer, 2), [&](string_view v){ released_views.push_back(v); });
+	c.send_borrowed(string_view(buffer, 4), [&](string_view v){ released_views.push_back(v); released.signal(); });
+
+	// The first buffer is handed back as soon as its own event has been handled, before the second one is.
+	string_view released_before_second;
+	auto h = [&](string_view v)
+	{
+		if(v.size() == 4)
+		{
+			released_before_second = released_views.empty() ? string_view() : released_views.front();
+		}
+	};
+	c.subscribe<decltype(h), string_view>(h);
+
+	proceed.signal();
+	released.wait();
+
+	REQUIRE(released_before_second == string_view(buffer, 2));
+	REQUIRE(released_views.size() == 2);
+}
+
+TEST_CASE("send_borrowed_dropped", "")
+{
+	semaphore entered(0), proceed(0), released(0);
+
+	event_channel::channel<event_channel::dispatch_policy::sequential, event_channel::idle_policy::drop_events> c;
+
+	auto f = [&](int)
+	{
+		entered.signal();
+		proceed.wait();
+	};
+	c.subscribe<decltype(f), int>(f);
+
+	// Hold the dispatching thread so that the borrowed event is still queued when the channel stops.
+	c.send(1);
+	entered.wait();
+
+	char const buffer[] = "orange";
+
+	size_t pending = 1;
+	c.send_borrowed(string_view(buffer), [&](string_view)
+		{
+			pending = c.pending();	// Calls back into the channel, which must not be locked.
+			released.signal();
+		});
+
+	thread t([&]{ c.stop(); });
+	released.wait();
+	proceed.signal();
+	t.join();
+
+	REQUIRE(pending == 0);
+	REQUIRE(c.memory_usage().dropped == 1);
+	REQUIRE(c.memory_usage().current == 0);
+
+	c.start();	// For the destructor to stop.
+}
+
+struct alignas(32) aligned_message
+{
+	int value;
+};
+
+TEST_CASE("variable_length", "")
+{
+	semaphore messages_acknowledged(1 - 4 * 3);
+
+	event_channel::channel<> c;
+
+	vector<string> received;
+	auto f1 = [&](int i)
+	{
+		received.push_back(to_string(i));
+		messages_acknowledged.signal();
+	};
+	auto f2 = [&](array<char, 200> const& a)
+	{
+		received.push_back(string(a.data()));
+		messages_acknowledged.signal();
+	};
+	auto f3 = [&](aligned_message const& m)
+	{
+		REQUIRE(reinterpret_cast<uintptr_t>(&m) % alignof(aligned_message) == 0);
+		received.push_back(to_string(m.value));
+		messages_acknowledged.signal();
+	};
+	c.subscribe<decltype(f1), int>(f1);
+	c.subscribe<decltype(f2), array<char, 200> const&>(f2);
+	c.subscribe<decltype(f3), aligned_message const&>(f3);
+
+	// Larger than the chunks events are usually stored in.
+	auto f4 = [&](array<int, 100 * 1024> const& a)
+	{
+		received.push_back(to_string(a.back()));
+		messages_acknowledged.signal();
+	};
+	c.subscribe<decltype(f4), array<int, 100 * 1024> const&>(f4);
+
+	auto const big_message = make_unique<array<int, 100 * 1024>>();
+	big_message->back() = 42;
+
+	vector<string> sent;
+	for(int i = 0; i != 3; ++i)
+	{
+		c.send(i);
+		sent.push_back(to_string(i));
+
+		array<char, 200> a{};
+		a[0] = 'a' + i;
+		c.send(a);
+		sent.push_back(string(a.data()));
+
+		c.send(aligned_message{i * 10});
+		sent.push_back(to_string(i * 10));
+
+		c.send(*big_message);
+		sent.push_back("42");
+	}
+
+	messages_acknowledged.wait();
+
+	REQUIRE(received == sent);
+}
+
+TEST_CASE("metrics", "")
+{
+	semaphore entered(0), proceed(0), done(1 - 2);
+
+	event_channel::channel<> c;
+	c.enable_metrics();
+	c.memory_budget(2 * sizeof(int) + sizeof(double), event_channel::budget_policy::drop_events);
+	c.warm_up<void (float)>();
+
+	auto f = [&](int)
+	{
+		entered.signal();
+		proceed.wait();
+		this_thread::sleep_for(chrono::milliseconds(1));
+		done.signal();
+	};
+	c.subscribe<decltype(f), int>(f);
+
+	c.send(1);
+	entered.wait();
+
+	c.send(2.);	// No subscriber, filtered.
+	c.send(3);
+	c.send(4);	// Over budget, dropped.
+
+	auto const find = [](vector<event_channel::event_type_metrics> const& metrics, type_index type)
+	{
+		return *find_if(metrics.begin(), metrics.end(), [&](auto const& m){ return m.type == type; });
+	};
+
+	auto i = find(c.metrics(), typeid(tuple<int>));
+	REQUIRE(i.sent == 3);
+	REQUIRE(i.dispatched == 1);
+	REQUIRE(i.dropped == 1);
+	REQUIRE(i.queue_depth == 1);
+
+	proceed.signal();
+	entered.wait();
+	proceed.signal();
+	done.wait();
+
+	c.send(5.f);	// An entry but no subscriber, filtered.
+
+	// The last handler's duration is recorded after it returns, hence after it signals.
+	// Wait for an unmeasured, and undroppable, event dispatched after it.
+	semaphore synchronized(0);
+	auto s = [&](char){ synchronized.signal(); };
+	c.subscribe<decltype(s), char>(s);
+	c.enable_metrics(false);
+	c.memory_budget(0);
+	c.send('s');
+	synchronized.wait();
+
+	auto const metrics = c.metrics();
+	REQUIRE(metrics.size() == 3);
+
+	i = find(metrics, typeid(tuple<int>));
+	REQUIRE(i.sent == 3);
+	REQUIRE(i.dispatched == 2);
+	REQUIRE(i.filtered == 0);
+	REQUIRE(i.queue_depth == 0);
+	REQUIRE(i.latency.count == 2);
+	REQUIRE(i.handler_duration.sum >= 2 * 1000000);
+	REQUIRE(i.handler_duration.percentile(100) >= i.handler_duration.percentile(50));
+	REQUIRE(i.handler_duration.percentile(100) == i.handler_duration.max);
+
+	auto const d = find(metrics, typeid(tuple<double>));
+	REQUIRE(d.sent == 1);
+	REQUIRE(d.dispatched == 0);
+	REQUIRE(d.filtered == 1);
+	REQUIRE(d.latency.count == 0);
+
+	auto const w = find(metrics, typeid(tuple<float>));
+	REQUIRE(w.dispatched == 0);
+	REQUIRE(w.filtered == 1);
+
+	REQUIRE(event_channel::histogram::index(7) == 7);
+	for(uint64_t v : {8ull, 9ull, 1000ull, 123456789ull})
+	{
+		auto const b = event_channel::histogram::index(v);
+		REQUIRE(event_channel::histogram::upper_bound(b) >= v);
+		REQUIRE(event_channel::histogram::upper_bound(b - 1) < v);
+	}
+}
+
+struct counting_instrumentation
+{
+	static atomic<int> enqueued, batches_begun, batches_ended, handlers_begun, handlers_ended;
+
+	static void enqueue(type_info const& type)
+	{
+		REQUIRE(type == typeid(tuple<int>));
+		++enqueued;
+	}
+
+	static void batch_begin(size_t)
+	{
+		++batches_begun;
+	}
+
+	static void handler_begin(type_info const&, event_channel::handler_tag_t)
+	{
+		++handlers_begun;
+	}
+
+	static void handler_end(type_info const&, event_channel::handler_tag_t)
+	{
+		++handlers_ended;
+	}
+
+	static void batch_end(size_t)
+	{
+		++batches_ended;
+	}
+};
+
+atomic<int> counting_instrumentation::enqueued{0}, counting_instrumentation::batches_begun{0}, counting_instrumentation::batches_ended{0}, counting_instrumentation::handlers_begun{0}, counting_instrumentation::handlers_ended{0};
+
+TEST_CASE("instrumentation", "")
+{
+	semaphore done(1 - 6);
+
+	{
+		event_channel::channel<event_channel::dispatch_policy::parallel, event_channel::idle_policy::keep_events, counting_instrumentation> c;
+
+		auto f = [&](int){ done.signal(); };
+		c.subscribe<decltype(f), int>(f);
+		auto g = [&](int){ done.signal(); };
+		c.subscribe<decltype(g), int>(g);
+
+		c.send(1);
+		c.send(2);
+		c.send(3);
+
+		done.wait();
+	}
+
+	REQUIRE(counting_instrumentation::enqueued == 3);
+	REQUIRE(counting_instrumentation::handlers_begun == 6);
+	REQUIRE(counting_instrumentation::handlers_ended == 6);
+	REQUIRE(counting_instrumentation::batches_begun >= 1);
+	REQUIRE(counting_instrumentation::batches_ended == counting_instrumentation::batches_begun);
+}
+
+struct sleeper
+{
+	semaphore& done;
+
+	void on(int ms)
+	{
+		this_thread::sleep_for(chrono::milliseconds(ms));
+		done.signal();
+	}
+};
+
+TEST_CASE("profiling", "")
+{
+	semaphore done(1 - 6);
+	sleeper s{done};
+
+	event_channel::channel<> c;
+	c.subscribe(&s, &sleeper::on);
+	c.enable_profiling();
+
+	auto f = [&](int){ done.signal(); };
+	auto const tag = c.subscribe<decltype(f), int>(f);
+
+	c.send(1);
+	c.send(2);
+	c.send(3);
+	done.wait();
+
+	auto profiles = c.slowest_handlers();
+	REQUIRE(profiles.size() == 2);
+
+	REQUIRE(profiles[0].tag != tag);
+	REQUIRE(profiles[0].handler_type.find("sleeper") != string::npos);
+	REQUIRE(profiles[0].event_type.find("int") != string::npos);
+	REQUIRE(profiles[0].invocations == 3);
+	REQUIRE(profiles[0].total >= chrono::milliseconds(6));
+	REQUIRE(profiles[0].max >= chrono::milliseconds(3));
+	REQUIRE(profiles[0].max <= profiles[0].total);
+	REQUIRE(profiles[0].cpu < profiles[0].total);
+
+	REQUIRE(profiles[1].tag == tag);
+	REQUIRE(profiles[1].invocations == 3);
+	REQUIRE(profiles[1].total < profiles[0].total);
+
+	REQUIRE(c.slowest_handlers(1).size() == 1);
+
+	ostringstream report;
+	report << profiles;
+	auto const lines = report.str();
+	REQUIRE(count(lines.begin(), lines.end(), '\n') == 3);
+
+	c.enable_profiling(false);
+	REQUIRE(c.slowest_handlers().empty());
+}
+
+TEST_CASE("trace", "")
+{
+	auto& recorder = event_channel::trace_recorder::instance();
+	auto const count = [&](string const& what)
+	{
+		ostringstream trace;
+		recorder.write(trace);
+
+		auto const json = trace.str();
+		REQUIRE(json.front() == '{');
+		REQUIRE(json.find("]}") != string::npos);
+
+		int n = 0;
+		for(auto i = json.find(what); i != string::npos; i = json.find(what, i + 1))
+		{
+			++n;
+		}
+		return n;
+	};
+
+	semaphore done(1 - 2);
+
+	{
+		event_channel::channel<event_channel::dispatch_policy::parallel, event_channel::idle_policy::keep_events, event_channel::instrumentation_policy::trace> c;
+
+		auto f = [&](int){ done.signal(); };
+		c.subscribe<decltype(f), int>(f);
+		auto g = [&](int){ done.signal(); };
+		c.subscribe<decltype(g), int>(g);
+
+		c.send(0);	// Not recorded.
+		done.wait();
+
+		// Under the parallel policy, handlers signal before they end. Wait for them to be done with the first event.
+		c.stop();
+		recorder.clear();
+		recorder.enable();
+		c.start();
+
+		c.send(1);
+		c.send(2);
+		for(int i = 0; i != 4; ++i)
+		{
+			done.wait();
+		}
+	}
+
+	recorder.enable(false);
+
+	REQUIRE(count("\"cat\":\"send\",\"name\":\"std::tuple<int>\"") == 2);
+	REQUIRE(count("\"ph\":\"B\",\"cat\":\"handler\"") == 4);
+	REQUIRE(count("\"ph\":\"E\",\"cat\":\"handler\"") == 4);
+	REQUIRE(count("\"ph\":\"B\",\"cat\":\"batch\"") >= 1);
+	REQUIRE(count("\"ph\":\"E\",\"cat\":\"batch\"") >= 1);
+
+	recorder.clear();
+	REQUIRE(count("\"cat\":\"send\"") == 0);
+}
+
+TEST_CASE("queue_lag", "")
+{
+	semaphore entered(0), proceed(0), crossed(0);
+	vector<bool> breaches;
+
+	event_channel::channel<> c;
+	c.on_lag(chrono::milliseconds(5), [&](chrono::nanoseconds lag, bool breached)
+		{
+			c.slowest_handlers();	// Takes the lock on subscribers, which must not be held.
+			breaches.push_back(breached && lag >= chrono::milliseconds(10));
+			crossed.signal();
+		});
+
+	auto f = [&](int)
+	{
+		entered.signal();
+		proceed.wait();
+	};
+	c.subscribe<decltype(f), int>(f);
+
+	REQUIRE(c.pending() == 0);
+	REQUIRE(c.oldest_age() == chrono::nanoseconds(0));
+
+	// Hold the dispatching thread in the first event's handler while more events queue up.
+	c.send(1);
+	entered.wait();
+
+	c.send(2);
+	c.send(3);
+	this_thread::sleep_for(chrono::milliseconds(10));
+
+	REQUIRE(c.pending() == 2);
+	REQUIRE(c.oldest_age() >= chrono::milliseconds(10));
+
+	proceed.signal();
+	crossed.wait();
+	entered.wait();
+	REQUIRE(c.pending() == 0);
+	proceed.signal();
+	entered.wait();
+	proceed.signal();
+
+	c.send(4);
+	crossed.wait();
+	entered.wait();
+	proceed.signal();
+
+	REQUIRE((breaches == vector<bool>{true, false}));
+
+	auto const batches = c.batch_sizes();
+	REQUIRE(batches.batches == 3);
+	REQUIRE(batches.events == 4);
+	REQUIRE(batches.max == 2);
+	REQUIRE(batches.last == 1);
+}
+
+TEST_CASE("lock_contention", "")
+{
+	semaphore entered(0), proceed(0);
+
+	event_channel::channel<> c;
+	c.enable_lock_stats();
+
+	auto f = [&](int)
+	{
+		entered.signal();
+		proceed.wait();
+	};
+	c.subscribe<decltype(f), int>(f);
+
+	// Hold the dispatching thread in a handler, and so the subscribers' lock, while another thread wants it.
+	c.send(1);
+	entered.wait();
+
+	thread t([&]{ c.slowest_handlers(); });
+	this_thread::sleep_for(chrono::milliseconds(10));
+	proceed.signal();
+	t.join();
+
+	// Let the dispatching thread wait for the next event.
+	this_thread::sleep_for(chrono::milliseconds(10));
+	c.send(2);
+	entered.wait();
+	proceed.signal();
+
+	auto const s = c.lock_contention();
+	REQUIRE(s.events.acquisitions >= 2);
+	REQUIRE(s.dispatchers.contended == 1);
+	REQUIRE(s.dispatchers.wait >= chrono::milliseconds(5));
+	REQUIRE(s.dispatchers.max_hold >= chrono::milliseconds(10));
+	REQUIRE(s.events_queued.wakeups >= 1);
+	REQUIRE(s.events_queued.spurious <= s.events_queued.wakeups);
+	REQUIRE(s.budget.wakeups == 0);
+
+	c.enable_lock_stats(false);
+	this_thread::sleep_for(chrono::milliseconds(10));
+	auto const acquisitions = c.lock_contention().events.acquisitions;
+	c.send(3);
+	entered.wait();
+	proceed.signal();
+	REQUIRE(c.lock_contention().events.acquisitions == acquisitions);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+TEST_CASE("shared_metrics", "")
+{
+	semaphore done(1 - 3);
+
+	event_channel::channel<> c;
+	c.enable_metrics();
+
+	auto f = [&](int){ done.signal(); };
+	c.subscribe<decltype(f), int>(f);
+
+	event_channel::metrics_exporter exporter("event_channel_correctness_shared_metrics", 1);
+	event_channel::metrics_reader reader("event_channel_correctness_shared_metrics");
+
+	REQUIRE(reader.read().event_types.empty());
+
+	c.send(1);
+	c.send(2);
+	c.send(3);
+	struct unpublished {};
+	c.send(unpublished{});	// Over the exporter's capacity.
+	done.wait();
+
+	exporter.publish(c);
+
+	auto const metrics = reader.read();
+	REQUIRE(metrics.pending == 0);
+	REQUIRE(metrics.event_types.size() == 1);
+	REQUIRE(metrics.event_types[0].first.find("int") != string::npos);
+	REQUIRE(metrics.event_types[0].second.sent == 3);
+	REQUIRE(metrics.event_types[0].second.latency.count == 3);
+	REQUIRE(metrics.event_types[0].second.latency.max == c.metrics()[0].latency.max);
+	REQUIRE(chrono::system_clock::now() - metrics.time < chrono::minutes(1));
+
+	REQUIRE_THROWS_AS(event_channel::metrics_reader("event_channel_correctness_no_such_segment"), system_error);
+}
+#endif
+
+TEST_CASE("openmetrics", "")
+{
+	auto& registry = event_channel::metrics_registry::instance();
+
+	semaphore done(1 - 2);
+
+	event_channel::channel<> orders, quotes;
+	orders.enable_metrics();
+
+	auto f = [&](int){ done.signal(); };
+	orders.subscribe<decltype(f), int>(f);
+
+	{
+		auto const o = registry.add("orders", orders);
+		auto const q = registry.add("quo\"tes", quotes);
+
+		orders.send(1);
+		orders.send(2);
+		done.wait();
+
+		auto const text = registry.render();
+		REQUIRE(text.find("# TYPE event_channel_events_sent counter\n") != string::npos);
+		REQUIRE(text.find("event_channel_events_sent_total{channel=\"orders\",event=\"std::tuple<int>\"} 2\n") != string::npos);
+		REQUIRE(text.find("event_channel_latency_seconds_bucket{channel=\"orders\",event=\"std::tuple<int>\",le=\"+Inf\"} 2\n") != string::npos);
+		REQUIRE(text.find("event_channel_latency_seconds_count{channel=\"orders\",event=\"std::tuple<int>\"} 2\n") != string::npos);
+		REQUIRE(text.find("event_channel_pending_events{channel=\"quo\\\"tes\"} 0\n") != string::npos);
+		REQUIRE(text.find("event_channel_batched_events_total{channel=\"orders\"}") != string::npos);
+		REQUIRE(text.substr(text.size() - 6) == "# EOF\n");
+	}
+
+	auto const text = registry.render();
+	REQUIRE(text.find("orders") == string::npos);
+	REQUIRE(text.find("quo") == string::npos);
+}
+
+TEST_CASE("flow_graph", "")
+{
+	auto& graph = event_channel::flow_graph::instance();
+	graph.clear();
+	graph.sample();
+
+	semaphore done(1 - 3);
+
+	{
+		event_channel::channel<> c;
+
+		auto f = [&](int i){ c.send(double(i)); };
+		auto const tag = c.subscribe<decltype(f), int>(f);
+		auto g = [&](double){ done.signal(); };
+		c.subscribe<decltype(g), double>(g);
+
+		c.send(1);
+		c.send(2);
+		c.send(3);
+		done.wait();
+
+		auto const edges = graph.edges();
+		REQUIRE(edges.size() == 1);
+		REQUIRE(edges[0].tag == tag);
+		REQUIRE(edges[0].input == "std::tuple<int>");
+		REQUIRE(edges[0].output == "std::tuple<double>");
+		REQUIRE(edges[0].count == 3);
+		REQUIRE(edges[0].max <= edges[0].total);
+	}
+
+	graph.sample(0);
+
+	ostringstream dot, json;
+	graph.write_dot(dot);
+	graph.write_json(json);
+	REQUIRE(dot.str().find("\"std::tuple<int>\" -> \"std::tuple<double>\"") != string::npos);
+	REQUIRE(json.str().find("\"count\":3") != string::npos);
+
+	graph.clear();
+	REQUIRE(graph.edges().empty());
+}
+
+struct registered_pod
+{
+	char c[24];
+};
+
+struct registered_string
+{
+	string s;
+};
+
+TEST_CASE("type_registry", "")
+{
+	auto const find = [](type_index type)
+		{
+			auto const types = event_channel::type_registry::types();
+			auto const i = find_if(types.begin(), types.end(), [&](auto const& t){ return t.type == type; });
+			return i == types.end() ? event_channel::event_type_info{} : *i;
+		};
+
+	semaphore go(0), done(1 - 2);
+
+	{
+		event_channel::channel<> c;
+
+		auto f = [&](registered_pod const&){ go.wait(); done.signal(); };
+		c.subscribe<decltype(f), registered_pod const&>(f);
+
+		auto pod = find(typeid(tuple<registered_pod>));
+		REQUIRE(pod.name == "std::tuple<registered_pod>");
+		REQUIRE(pod.size == sizeof(registered_pod));
+		REQUIRE(pod.alignment == alignof(registered_pod));
+		REQUIRE(pod.trivially_copyable);
+		REQUIRE(pod.subscriptions == 1);
+		REQUIRE(pod.constructed == 0);
+
+		c.send(registered_pod{});
+		c.send(registered_pod{});
+		c.send(registered_string{"expensive"});
+
+		pod = find(typeid(tuple<registered_pod>));
+		REQUIRE(pod.constructed == 2);
+		REQUIRE(pod.live >= 1);
+
+		auto const string = find(typeid(tuple<registered_string>));
+		REQUIRE(string.name == "std::tuple<registered_string>");
+		REQUIRE(!string.trivially_copyable);
+		REQUIRE(string.subscriptions == 0);
+		REQUIRE(string.constructed == 1);
+
+		go.signal();
+		go.signal();
+		done.wait();
+	}
+
+	// The channel destroyed whatever it still had queued.
+	REQUIRE(find(typeid(tuple<registered_pod>)).live == 0);
+	REQUIRE(find(typeid(tuple<registered_string>)).live == 0);
+
+	ostringstream table;
+	table << event_channel::type_registry::types();
+	REQUIRE(table.str().find("24\t1\tyes\t0\t2\t1\tstd::tuple<registered_pod>\n") != string::npos);
+}
+
 // Simple sanity check test cases that vary a single parameter between: type, number of messages sent, 
 // number of receivers the message is sent to, the priority policy and the dispatch_policy.
 TEST_CASE("i_1_1_f_s", "")
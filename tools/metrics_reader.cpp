@@ -0,0 +1,115 @@
+#include "event_channel.h"
+
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+// Prints the metrics an event_channel::metrics_exporter publishes, from outside the publishing process.
+//
+// Usage: metrics_reader <segment name> [--json] [--watch <milliseconds>]
+
+void print_table(event_channel::published_metrics const& metrics)
+{
+	auto const time = chrono::system_clock::to_time_t(metrics.time);
+	cout << put_time(localtime(&time), "%F %T") << "  pending " << metrics.pending
+		 << "  memory " << metrics.memory.current << " B (peak " << metrics.memory.peak << " B, budget " << metrics.memory.budget << " B, dropped " << metrics.memory.dropped << ")\n";
+
+	cout << setw(12) << "sent" << setw(12) << "dispatched" << setw(10) << "dropped" << setw(10) << "filtered" << setw(8) << "depth"
+		 << setw(12) << "p50 (ns)" << setw(12) << "p99 (ns)" << setw(12) << "max (ns)" << setw(14) << "handler p99" << "  event\n";
+
+	for(auto const& [name, m] : metrics.event_types)
+	{
+		cout << setw(12) << m.sent << setw(12) << m.dispatched << setw(10) << m.dropped << setw(10) << m.filtered << setw(8) << m.queue_depth
+			 << setw(12) << m.latency.percentile(50) << setw(12) << m.latency.percentile(99) << setw(12) << m.latency.max
+			 << setw(14) << m.handler_duration.percentile(99) << "  " << name << '\n';
+	}
+	cout << endl;
+}
+
+void print_histogram(event_channel::histogram::snapshot_t const& h)
+{
+	cout << "{\"count\":" << h.count << ",\"sum\":" << h.sum << ",\"max\":" << h.max << ",\"buckets\":[";
+
+	char const* separator = "";
+	for(size_t i = 0; i != h.counts.size(); ++i)
+	{
+		if(h.counts[i])
+		{
+			cout << separator << "{\"le\":" << event_channel::histogram::upper_bound(i) << ",\"count\":" << h.counts[i] << '}';
+			separator = ",";
+		}
+	}
+	cout << "]}";
+}
+
+void print_json(event_channel::published_metrics const& metrics)
+{
+	cout << "{\"time\":" << chrono::duration_cast<chrono::milliseconds>(metrics.time.time_since_epoch()).count()
+		 << ",\"pending\":" << metrics.pending
+		 << ",\"memory\":{\"current\":" << metrics.memory.current << ",\"peak\":" << metrics.memory.peak << ",\"budget\":" << metrics.memory.budget << ",\"dropped\":" << metrics.memory.dropped << '}'
+		 << ",\"event_types\":[";
+
+	char const* separator = "";
+	for(auto const& [name, m] : metrics.event_types)
+	{
+		cout << separator << "{\"name\":\"" << name << "\",\"sent\":" << m.sent << ",\"dispatched\":" << m.dispatched << ",\"dropped\":" << m.dropped
+			 << ",\"filtered\":" << m.filtered << ",\"queue_depth\":" << m.queue_depth << ",\"latency\":";
+		print_histogram(m.latency);
+		cout << ",\"handler_duration\":";
+		print_histogram(m.handler_duration);
+		cout << '}';
+		separator = ",";
+	}
+	cout << "]}" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		cerr << "Usage: " << argv[0] << " <segment name> [--json] [--watch <milliseconds>]\n";
+		return 1;
+	}
+
+	bool json = false;
+	int watch = 0;
+	for(int i = 2; i < argc; ++i)
+	{
+		if(strcmp(argv[i], "--json") == 0)
+		{
+			json = true;
+		}
+		else if(strcmp(argv[i], "--watch") == 0 && i + 1 < argc)
+		{
+			watch = stoi(argv[++i]);
+		}
+	}
+
+	try
+	{
+		event_channel::metrics_reader reader(argv[1]);
+
+		do
+		{
+			auto const metrics = reader.read();
+			json ? print_json(metrics) : print_table(metrics);
+
+			this_thread::sleep_for(chrono::milliseconds(watch));
+		}
+		while(watch);
+	}
+	catch(exception const& e)
+	{
+		cerr << e.what() << '\n';
+		return 1;
+	}
+
+	return 0;
+}